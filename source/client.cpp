@@ -0,0 +1,339 @@
+#include "../include/client.hpp"
+#include "../include/odf_types.hpp"
+#include <future>
+#include <chrono>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+static const int EXPIRE_INTERVAL_MS = 100; // how often readers look for timed-out requests
+
+static json error_response(OFSErrorCodes code, const std::string &message, const json &request_id) {
+    json res = {{"status", "error"},
+                {"code", static_cast<int32_t>(code)},
+                {"error_message", message}};
+    if (!request_id.is_null()) res["request_id"] = request_id;
+    return res;
+}
+
+static bool write_all(int fd, const std::string &data) {
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t n = send(fd, data.data() + done, data.size() - done, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+OFSClient::OFSClient(ClientOptions opts) : options(std::move(opts)) {
+    if (options.pool_size == 0) options.pool_size = 1;
+}
+
+OFSClient::~OFSClient() {
+    close();
+}
+
+// ===================== CONNECTIONS =====================
+int OFSClient::open_socket(std::string &error_msg) const {
+    if (!options.unix_socket_path.empty()) {
+        sockaddr_un addr{};
+        if (options.unix_socket_path.size() >= sizeof(addr.sun_path)) { error_msg = "unix socket path too long"; return -1; }
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, options.unix_socket_path.c_str(), sizeof(addr.sun_path) - 1);
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) { error_msg = std::string("socket failed: ") + std::strerror(errno); return -1; }
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            error_msg = "Cannot connect to " + options.unix_socket_path + ": " + std::strerror(errno);
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *found = nullptr;
+    std::string port = std::to_string(options.port);
+    int rc = getaddrinfo(options.host.c_str(), port.c_str(), &hints, &found);
+    if (rc != 0) { error_msg = "Cannot resolve " + options.host + ": " + gai_strerror(rc); return -1; }
+
+    int fd = -1;
+    for (addrinfo *ai = found; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) continue;
+        if (::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+        ::close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(found);
+    if (fd < 0) { error_msg = "Cannot connect to " + options.host + ":" + port + ": " + std::strerror(errno); return -1; }
+
+    // Requests are small and pipelined; don't let Nagle hold them back.
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+bool OFSClient::reconnect(PoolConnection &c, std::string &error_msg) {
+    int fd = open_socket(error_msg);
+    if (fd < 0) return false;
+    // The reader wakes up now and then to expire requests even when the
+    // server has gone quiet.
+    if (options.request_timeout_ms > 0) {
+        timeval tv{0, EXPIRE_INTERVAL_MS * 1000};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    }
+    std::lock_guard<std::mutex> lock(c.write_mtx);
+    c.fd = fd;
+    c.up = true;
+    return true;
+}
+
+// Takes the connection out of service. New requests see fd < 0 under
+// write_mtx, so none can be registered after the pending map is taken.
+void OFSClient::drop(PoolConnection &c, int fd) {
+    {
+        std::lock_guard<std::mutex> lock(c.write_mtx);
+        if (c.fd != fd || fd < 0) return;
+        ::close(fd);
+        c.fd = -1;
+        c.up = false;
+    }
+    fail_pending(c, stopping ? "Client closed" : "Connection lost");
+}
+
+void OFSClient::fail_pending(PoolConnection &c, const std::string &reason) {
+    std::unordered_map<uint64_t, Pending> failed;
+    {
+        std::lock_guard<std::mutex> lock(c.pending_mtx);
+        failed.swap(c.pending);
+    }
+    c.in_flight -= failed.size();
+    for (auto &p : failed)
+        p.second.callback(error_response(OFSErrorCodes::ERROR_IO_ERROR, reason, p.second.request_id));
+}
+
+// Fails the requests whose deadline has passed. Their ids are gone from
+// the map, so dispatch() drops a reply that arrives later.
+void OFSClient::expire_pending(PoolConnection &c) {
+    auto now = std::chrono::steady_clock::now();
+    std::vector<Pending> expired;
+    {
+        std::lock_guard<std::mutex> lock(c.pending_mtx);
+        for (auto it = c.pending.begin(); it != c.pending.end();) {
+            if (it->second.deadline <= now) {
+                expired.push_back(std::move(it->second));
+                it = c.pending.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    c.in_flight -= expired.size();
+    for (auto &p : expired)
+        p.callback(error_response(OFSErrorCodes::ERROR_IO_ERROR, "Timed out waiting for response", p.request_id));
+}
+
+bool OFSClient::connect(std::string &error_msg) {
+    if (!pool.empty()) return true;
+    stopping = false;
+    size_t connected = 0;
+    for (size_t i = 0; i < options.pool_size; ++i) {
+        auto c = std::make_unique<PoolConnection>();
+        c->index = i;
+        std::string err;
+        if (reconnect(*c, err)) ++connected;
+        else error_msg = err;
+        pool.push_back(std::move(c));
+    }
+    if (connected == 0) {
+        pool.clear();
+        return false;
+    }
+    for (auto &c : pool) {
+        PoolConnection *pc = c.get();
+        pc->reader = std::thread([this, pc] { reader_loop(*pc); });
+    }
+    return true;
+}
+
+void OFSClient::close() {
+    if (pool.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(wait_mtx);
+        stopping = true;
+    }
+    wait_cv.notify_all();
+    for (auto &c : pool) {
+        {
+            std::lock_guard<std::mutex> lock(c->write_mtx);
+            if (c->fd >= 0) shutdown(c->fd, SHUT_RDWR); // wakes the reader
+        }
+        if (c->reader.joinable()) c->reader.join();
+        int fd;
+        {
+            std::lock_guard<std::mutex> lock(c->write_mtx);
+            fd = c->fd;
+        }
+        drop(*c, fd);
+    }
+    pool.clear();
+}
+
+// ===================== RESPONSES =====================
+void OFSClient::reader_loop(PoolConnection &c) {
+    std::string buf;
+    std::vector<char> chunk(64 * 1024);
+    int backoff = options.reconnect_min_ms;
+    auto next_expiry = std::chrono::steady_clock::now();
+
+    while (!stopping) {
+        int fd;
+        {
+            std::lock_guard<std::mutex> lock(c.write_mtx);
+            fd = c.fd;
+        }
+        if (fd < 0) {
+            std::string err;
+            if (reconnect(c, err)) { backoff = options.reconnect_min_ms; buf.clear(); continue; }
+            std::unique_lock<std::mutex> lock(wait_mtx);
+            wait_cv.wait_for(lock, std::chrono::milliseconds(backoff), [this] { return stopping.load(); });
+            backoff = std::min(backoff * 2, options.reconnect_max_ms);
+            continue;
+        }
+
+        ssize_t n = recv(fd, chunk.data(), chunk.size(), 0);
+        if (options.request_timeout_ms > 0 && std::chrono::steady_clock::now() >= next_expiry) {
+            expire_pending(c);
+            next_expiry = std::chrono::steady_clock::now() + std::chrono::milliseconds(EXPIRE_INTERVAL_MS);
+        }
+        if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) continue;
+        if (n <= 0) { drop(c, fd); continue; }
+        buf.append(chunk.data(), static_cast<size_t>(n));
+
+        size_t start = 0, pos;
+        while ((pos = buf.find('\n', start)) != std::string::npos) {
+            if (pos > start) dispatch(c, buf.data() + start, pos - start);
+            start = pos + 1;
+        }
+        if (start > 0) buf.erase(0, start);
+    }
+}
+
+void OFSClient::dispatch(PoolConnection &c, const char *line, size_t len) {
+    json res = json::parse(line, line + len, nullptr, false);
+    if (res.is_discarded() || !res.is_object()) return;
+    auto id_field = res.find("request_id");
+    if (id_field == res.end() || !id_field->is_string()) return;
+
+    uint64_t id = std::strtoull(id_field->get_ref<const std::string&>().c_str(), nullptr, 10);
+    Pending p;
+    {
+        std::lock_guard<std::mutex> lock(c.pending_mtx);
+        auto it = c.pending.find(id);
+        if (it == c.pending.end()) return;
+        p = std::move(it->second);
+        c.pending.erase(it);
+    }
+    --c.in_flight;
+
+    if (p.request_id.is_null()) res.erase("request_id");
+    else res["request_id"] = p.request_id;
+    p.callback(res);
+}
+
+// ===================== REQUESTS =====================
+// Least loaded live connection, so one slow response doesn't hold up
+// requests that could go elsewhere.
+OFSClient::PoolConnection* OFSClient::pick() {
+    PoolConnection *best = nullptr;
+    for (auto &c : pool) {
+        if (!c->up) continue;
+        if (!best || c->in_flight < best->in_flight) best = c.get();
+    }
+    return best;
+}
+
+void OFSClient::send_async(json request, ResponseCallback callback) {
+    json caller_id = request.is_object() && request.contains("request_id") ? request["request_id"] : json();
+    if (!request.is_object()) {
+        callback(error_response(OFSErrorCodes::ERROR_INVALID_OPERATION, "Request must be a JSON object", caller_id));
+        return;
+    }
+    if (!request.contains("session_id")) {
+        std::lock_guard<std::mutex> lock(session_mtx);
+        if (!session_id.empty()) request["session_id"] = session_id;
+    }
+
+    uint64_t id = next_id++;
+    request["request_id"] = std::to_string(id);
+    auto deadline = options.request_timeout_ms > 0
+        ? std::chrono::steady_clock::now() + std::chrono::milliseconds(options.request_timeout_ms)
+        : std::chrono::steady_clock::time_point::max();
+    std::string line;
+    try {
+        line = request.dump();
+    } catch (const std::exception &e) {
+        callback(error_response(OFSErrorCodes::ERROR_INVALID_OPERATION, e.what(), caller_id));
+        return;
+    }
+    line.push_back('\n');
+
+    PoolConnection *c = pick();
+    if (c) {
+        std::lock_guard<std::mutex> lock(c->write_mtx);
+        if (c->fd >= 0) {
+            {
+                std::lock_guard<std::mutex> plock(c->pending_mtx);
+                c->pending.emplace(id, Pending{std::move(callback), caller_id, deadline});
+            }
+            ++c->in_flight;
+            // On failure the reader sees the shutdown and fails the request.
+            if (!write_all(c->fd, line)) shutdown(c->fd, SHUT_RDWR);
+            return;
+        }
+    }
+    callback(error_response(OFSErrorCodes::ERROR_IO_ERROR, "Not connected", caller_id));
+}
+
+// The reader fails the request once request_timeout_ms passes, so the
+// wait always ends.
+json OFSClient::call(json request) {
+    auto done = std::make_shared<std::promise<json>>();
+    std::future<json> result = done->get_future();
+    send_async(std::move(request), [done](const json &res) { done->set_value(res); });
+    return result.get();
+}
+
+bool OFSClient::login(const std::string &username, const std::string &password, std::string &error_msg) {
+    json res = call({{"operation", "user_login"},
+                     {"payload", {{"username", username}, {"password", password}}}});
+    if (res.value("status", "") != "success") {
+        error_msg = res.value("error_message", res.value("message", "Login failed"));
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(session_mtx);
+    session_id = res["data"].value("session_id", "");
+    return true;
+}
+
+std::string OFSClient::session() {
+    std::lock_guard<std::mutex> lock(session_mtx);
+    return session_id;
+}
+
+size_t OFSClient::in_flight() const {
+    size_t n = 0;
+    for (auto &c : pool) n += c->in_flight;
+    return n;
+}
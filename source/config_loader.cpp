@@ -86,8 +86,26 @@ bool ConfigLoader::load(const std::string &path, Config &config, std::string &er
 
         else if (current_section == "server") {
             if (key == "port") config.port = static_cast<uint16_t>(std::stoul(value));
+            else if (key == "http_port") config.http_port = static_cast<uint16_t>(std::stoul(value));
+            else if (key == "unix_socket_path") config.unix_socket_path = value;
             else if (key == "max_connections") config.max_connections = std::stoul(value);
             else if (key == "queue_timeout") config.queue_timeout = std::stoul(value);
+            else if (key == "io_threads") config.io_threads = std::stoul(value);
+            else if (key == "io_backend") config.io_backend = value;
+            else if (key == "worker_threads") config.worker_threads = std::stoul(value);
+            else if (key == "bulk_workers") config.bulk_workers = std::stoul(value);
+            else if (key == "queue_capacity") config.queue_capacity = std::stoul(value);
+            else if (key == "allocation_groups") config.allocation_groups = std::stoul(value);
+        }
+
+        else if (current_section == "limits") {
+            if (key == "session_control") config.session_rate_control = std::stoul(value);
+            else if (key == "session_metadata") config.session_rate_metadata = std::stoul(value);
+            else if (key == "session_bulk") config.session_rate_bulk = std::stoul(value);
+            else if (key == "connection_control") config.connection_rate_control = std::stoul(value);
+            else if (key == "connection_metadata") config.connection_rate_metadata = std::stoul(value);
+            else if (key == "connection_bulk") config.connection_rate_bulk = std::stoul(value);
+            else if (key == "burst_seconds") config.burst_seconds = std::stod(value);
         }
     }
 
@@ -14,6 +14,7 @@ OFSErrorCodes DirOperations::dir_create(const std::string &path) {
     node->entry = entry;
 
     parent->children[name] = std::move(node);  // Move into unordered_map
+    ++counts->directories;
     return OFSErrorCodes::SUCCESS;
 }
 
@@ -31,6 +32,7 @@ OFSErrorCodes DirOperations::dir_delete(const std::string &path) {
 
     // No need to delete manually; unique_ptr handles it
     parent->children.erase(it);
+    --counts->directories;
     return OFSErrorCodes::SUCCESS;
 }
 
@@ -42,10 +44,18 @@ bool DirOperations::dir_exists(const std::string &path) {
 // List contents of directory
 std::vector<std::string> DirOperations::dir_list(const std::string &path) {
     std::vector<std::string> list;
+    dir_list(path, [&list](const std::string &name, bool is_dir) {
+        list.push_back(is_dir ? name + "/" : name);
+    });
+    return list;
+}
+
+bool DirOperations::dir_list(const std::string &path,
+                             const std::function<void(const std::string &, bool)> &visit) {
     DirNode* node = resolver->locate_dir(path);
-    if (!node) return list;
+    if (!node) return false;
 
-    for (auto &c : node->children) list.push_back(c.first + "/");
-    for (auto &f : node->files) list.push_back(f.first);
-    return list;
+    for (auto &c : node->children) visit(c.first, true);
+    for (auto &f : node->files) visit(f.first, false);
+    return true;
 }
@@ -1,6 +1,5 @@
 #include "../include/dir_tree.hpp"
-#include <functional>   // Needed for std::function
-#include <sstream>
+#include "../include/request_arena.hpp"
 #include <vector>
 #include <string>
 #include <algorithm>    // optional, for counting used blocks if needed
@@ -18,10 +17,9 @@ DirNode* DirectoryTree::get_root() const { return root.get(); }
 DirNode* DirectoryTree::find_directory(const std::string &path) {
     if (path == "/") return root.get();
     DirNode* current = root.get();
-    std::stringstream ss(path);
     std::string segment;
-    while (std::getline(ss, segment, '/')) {
-        if (segment.empty()) continue;
+    for (std::string_view part : split_path(path)) {
+        segment.assign(part);
         auto it = current->children.find(segment);
         if (it == current->children.end()) return nullptr;
         current = it->second.get(); // Use .get() on unique_ptr
@@ -35,7 +33,9 @@ DirNode* DirectoryTree::add_directory(const std::string &path, const FileEntry &
     if (!parent) return nullptr;
     auto new_dir = std::make_unique<DirNode>(entry);
     DirNode* ptr = new_dir.get();
-    parent->children[entry.name] = std::move(new_dir);
+    auto &slot = parent->children[entry.name];
+    if (!slot) ++counts.directories;
+    slot = std::move(new_dir);
     return ptr;
 }
 
@@ -43,39 +43,27 @@ DirNode* DirectoryTree::add_directory(const std::string &path, const FileEntry &
 bool DirectoryTree::add_file(const std::string &dir_path, const FileEntry &file_entry) {
     DirNode* dir = find_directory(dir_path);
     if (!dir) return false;
-    dir->files[file_entry.name] = file_entry;
+    if (dir->files.insert_or_assign(file_entry.name, file_entry).second) ++counts.files;
     return true;
 }
 
-// Count files recursively
 size_t DirectoryTree::count_files() {
-    size_t counter = 0;
-    std::function<void(DirNode*)> dfs = [&](DirNode* node) {
-        counter += node->files.size();
-        for (auto &c : node->children) dfs(c.second.get()); // Use .get()
-    };
-    dfs(root.get());
-    return counter;
+    return counts.files;
 }
 
-// Count directories recursively
 size_t DirectoryTree::count_directories() {
-    size_t counter = 0;
-    std::function<void(DirNode*)> dfs = [&](DirNode* node) {
-        ++counter;
-        for (auto &c : node->children) dfs(c.second.get()); // Use .get()
-    };
-    dfs(root.get());
-    return counter;
+    return counts.directories;
 }
 
 // -------------------- Utilities --------------------
-std::vector<std::string> split_path(const std::string &path) {
-    std::stringstream ss(path);
-    std::string part;
-    std::vector<std::string> result;
-    while (std::getline(ss, part, '/')) {
-        if (!part.empty()) result.push_back(part);
+std::pmr::vector<std::string_view> split_path(const std::string &path) {
+    std::pmr::vector<std::string_view> result(request_memory());
+    size_t start = 0;
+    while (start < path.size()) {
+        size_t end = path.find('/', start);
+        if (end == std::string::npos) end = path.size();
+        if (end > start) result.emplace_back(path.data() + start, end - start);
+        start = end + 1;
     }
     return result;
 }
@@ -85,11 +73,13 @@ std::pair<DirNode*, std::string> locate_parent(DirNode* root, const std::string
     auto parts = split_path(path);
     if (parts.empty()) return {nullptr, ""};
 
-    std::string name = parts.back();
+    std::string name(parts.back());
     parts.pop_back();
 
     DirNode* current = root;
-    for (const auto &folder : parts) {
+    std::string folder;
+    for (std::string_view part : parts) {
+        folder.assign(part);
         auto it = current->children.find(folder);
         if (it == current->children.end()) return {nullptr, ""};
         current = it->second.get(); // Use .get() on unique_ptr
@@ -0,0 +1,703 @@
+#include "../include/event_loop.hpp"
+#include "../include/globals.hpp"
+#include "../include/operations.hpp"
+#include "../include/io_backend.hpp"
+#include "../include/shm_transport.hpp"
+#include "../include/logger.hpp"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+
+static const int MAX_EVENTS = 256;
+
+bool set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) return false;
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+EventLoop::~EventLoop() {
+    for (auto &kv : connections) {
+        kv.second->closed = true;
+        close(kv.first);
+    }
+    if (wake_fd >= 0) close(wake_fd);
+    if (epoll_fd >= 0) close(epoll_fd);
+}
+
+bool EventLoop::init(std::string &error_msg) {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) { error_msg = "epoll_create1 failed"; return false; }
+
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd < 0) { error_msg = "eventfd failed"; return false; }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = wake_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev) < 0) { error_msg = "Failed to register eventfd"; return false; }
+
+    if (io::backend() == IoBackend::IO_URING) {
+        uring = std::make_unique<IoUring>();
+        std::string err;
+        if (!uring->init(MAX_EVENTS, err)) {
+            std::cerr << "[ERROR] " << err << ", event loop falls back to writev()\n";
+            uring.reset();
+        }
+    }
+
+    return true;
+}
+
+bool EventLoop::add_listener(int listen_socket, WireProtocol protocol, bool local, std::string &error_msg) {
+    if (!set_nonblocking(listen_socket)) { error_msg = "Failed to make listener non-blocking"; return false; }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = listen_socket;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_socket, &ev) < 0) { error_msg = "Failed to register listener"; return false; }
+
+    listeners.push_back({listen_socket, protocol, local});
+    return true;
+}
+
+// ===================== MAIN LOOP =====================
+void EventLoop::run() {
+    epoll_event events[MAX_EVENTS];
+    std::vector<std::shared_ptr<Connection>> writable;
+
+    while (!g_shutdown_flag) {
+        // Don't sleep while a connection still has bytes waiting.
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, unread.empty() ? 1000 : 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait failed");
+            break;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == wake_fd) { handle_wakeup(); continue; }
+            auto lst = std::find_if(listeners.begin(), listeners.end(),
+                                    [fd](const Listener &l) { return l.fd == fd; });
+            if (lst != listeners.end()) { handle_accept(*lst); continue; }
+
+            auto it = connections.find(fd);
+            if (it == connections.end()) continue;
+            std::shared_ptr<Connection> conn = it->second;
+
+            if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                close_connection(conn);
+                continue;
+            }
+            if (events[i].events & EPOLLIN) handle_readable(conn);
+            if ((events[i].events & EPOLLOUT) && !conn->closed) writable.push_back(conn);
+        }
+        read_unread();
+        flush_all(writable);
+        writable.clear();
+    }
+}
+
+// ===================== ACCEPT =====================
+void EventLoop::handle_accept(const Listener &listener) {
+    while (true) {
+        int client_socket = accept4(listener.fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_socket < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) perror("accept failed");
+            return;
+        }
+
+        if (max_connections && g_server_metrics.connections_active >= max_connections) {
+            reject_connection(client_socket, listener.protocol);
+            continue;
+        }
+
+        // Responses are already batched per writev(), so never let Nagle
+        // hold back the tail of one.
+        if (!listener.local) {
+            int one = 1;
+            setsockopt(client_socket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+
+        auto conn = std::make_shared<Connection>();
+        conn->fd = client_socket;
+        conn->loop = this;
+        conn->protocol = listener.protocol;
+        conn->local = listener.local;
+
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+        ev.data.fd = client_socket;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_socket, &ev) < 0) {
+            perror("epoll_ctl add client failed");
+            close(client_socket);
+            continue;
+        }
+        connections[client_socket] = conn;
+        g_server_metrics.connections_accepted++;
+        g_server_metrics.connections_active++;
+    }
+}
+
+// Over the connection limit: answer with a single busy error and hang up
+// rather than letting the client sit in the backlog.
+void EventLoop::reject_connection(int fd, WireProtocol protocol) {
+    static const std::string body = json{
+        {"status", "error"},
+        {"code", static_cast<int32_t>(OFSErrorCodes::ERROR_SERVER_BUSY)},
+        {"error_message", ofs_code_to_message(OFSErrorCodes::ERROR_SERVER_BUSY)},
+        {"operation", ""},
+        {"request_id", ""}
+    }.dump();
+    static const std::string busy_line = body + "\n";
+    static const std::string busy_http = http::build_response(503, body, false);
+    const std::string &busy = protocol == WireProtocol::HTTP ? busy_http : busy_line;
+
+    ssize_t ignored = send(fd, busy.data(), busy.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+    (void)ignored;
+    close(fd);
+    g_server_metrics.connections_rejected++;
+}
+
+// ===================== READ =====================
+void EventLoop::handle_readable(const std::shared_ptr<Connection> &conn) {
+    char buffer[16384];
+    bool peer_closed = false;
+    bool protocol_error = false;
+    bool over_budget = false;
+    size_t total = 0;
+
+    // Paused connections leave their bytes in the socket until the queue drains.
+    while (!conn->paused) {
+        // One busy client must not keep the loop from everyone else.
+        if (total >= READ_BUDGET) { over_budget = true; break; }
+        bool direct = conn->frame_meta_done && conn->frame_filled < conn->frame_hdr.payload_len;
+        size_t room = sizeof(buffer);
+        if (direct) {
+            room = static_cast<size_t>(std::min<uint64_t>(conn->frame_hdr.payload_len - conn->frame_filled, READ_BUDGET));
+            conn->frame_payload.resize(conn->frame_filled + room);
+        }
+        char* dst = direct ? conn->frame_payload.data() + conn->frame_filled : buffer;
+
+        ssize_t bytes = recv(conn->fd, dst, room, 0);
+        if (direct) conn->frame_payload.resize(conn->frame_filled + static_cast<size_t>(std::max<ssize_t>(bytes, 0)));
+        if (bytes > 0) {
+            total += static_cast<size_t>(bytes);
+            if (direct) conn->frame_filled += static_cast<size_t>(bytes);
+            else conn->in_buf.append(buffer, static_cast<size_t>(bytes));
+            // Frames are cheap to parse incrementally, and doing so lets the
+            // payload of a large one bypass in_buf entirely.
+            if (conn->protocol != WireProtocol::LINE) {
+                if (!process_input(conn)) { protocol_error = true; break; }
+            } else if (conn->in_buf.size() > MAX_LINE_BYTES) {
+                // Lines are parsed once the socket is drained; past the cap,
+                // parse now and give up if what remains is still one line.
+                if (!process_input(conn) || (!conn->paused && conn->in_buf.size() > MAX_LINE_BYTES)) {
+                    protocol_error = true;
+                    break;
+                }
+            }
+            continue;
+        }
+        if (bytes == 0) { peer_closed = true; break; }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        peer_closed = true;
+        break;
+    }
+
+    if (!protocol_error && !process_input(conn)) protocol_error = true;
+
+    if (peer_closed || protocol_error || (!conn->paused && conn->in_buf.size() > MAX_LINE_BYTES)) {
+        close_connection(conn);
+        return;
+    }
+    if (over_budget && !conn->paused && !conn->read_pending) {
+        conn->read_pending = true;
+        unread.push_back(conn);
+    }
+}
+
+void EventLoop::read_unread() {
+    std::vector<std::shared_ptr<Connection>> waiting;
+    waiting.swap(unread);
+    for (auto &conn : waiting) {
+        conn->read_pending = false;
+        if (conn->closed || conn->paused) continue; // resume_paused reads paused ones
+        handle_readable(conn);
+    }
+}
+
+// Over the rate limit a request is answered right here and never reaches
+// the queue; otherwise it is pushed to its lane.
+bool EventLoop::enqueue(const std::shared_ptr<Connection> &conn, Request &&r) {
+    r.lane = operation_lane(r.args.operation, !r.payload.empty());
+    uint32_t retry_after_ms = 0;
+    if (!g_rate_limiter.admit(conn->limits, r.args.session_id, r.lane, retry_after_ms)) {
+        reply_throttled(conn, r, retry_after_ms);
+        return true;
+    }
+    return push(conn, std::move(r));
+}
+
+// Queues r on its lane, or parks it on the connection and pauses reading
+// if that lane is full.
+bool EventLoop::push(const std::shared_ptr<Connection> &conn, Request &&r) {
+    if (!queue.try_push(std::move(r))) {
+        conn->stalled = std::move(r);
+        conn->paused = true;
+        paused.push_back(conn);
+        g_server_metrics.backpressure_pauses++;
+        return false;
+    }
+    g_server_metrics.requests_enqueued++;
+    return true;
+}
+
+// Returns false if the connection broke the protocol and must be closed.
+bool EventLoop::process_input(const std::shared_ptr<Connection> &conn) {
+    if (conn->paused) return true;
+    if (conn->protocol == WireProtocol::UNKNOWN) {
+        if (conn->in_buf.empty()) return true;
+        if (conn->in_buf[0] == frame::MAGIC[0]) {
+            if (conn->in_buf.size() < sizeof(frame::MAGIC)) return true;
+            conn->protocol = frame::has_magic(conn->in_buf.data()) ? WireProtocol::FRAMED : WireProtocol::LINE;
+        } else {
+            conn->protocol = WireProtocol::LINE;
+        }
+    }
+    if (conn->protocol == WireProtocol::HTTP) return process_http(conn);
+    return conn->protocol == WireProtocol::FRAMED ? process_frames(conn) : process_lines(conn);
+}
+
+bool EventLoop::process_lines(const std::shared_ptr<Connection> &conn) {
+    std::string &data_buffer = conn->in_buf;
+    size_t start = 0;
+    size_t pos;
+    while (!conn->paused && (pos = data_buffer.find('\n', start)) != std::string::npos) {
+        size_t len = pos - start;
+        size_t line_start = start;
+        start = pos + 1;
+        if (len == 0) continue;
+
+        Request r;
+        if (!parse_request(data_buffer.data() + line_start, data_buffer.data() + pos, r.args, r.request)) {
+            LOG_ERROR("Invalid JSON: %.*s", static_cast<int>(len), data_buffer.data() + line_start);
+            continue;
+        }
+        r.conn = conn;
+        // Queue full: the request waits on the connection and reading stops
+        // until the workers catch up.
+        enqueue(conn, std::move(r));
+    }
+    if (start > 0) data_buffer.erase(0, start);
+    return true;
+}
+
+bool EventLoop::process_frames(const std::shared_ptr<Connection> &conn) {
+    std::string &buf = conn->in_buf;
+    size_t pos = 0;
+    bool ok = true;
+
+    while (!conn->paused) {
+        if (!conn->frame_active) {
+            if (buf.size() - pos < frame::HEADER_SIZE) break;
+            frame::Header h;
+            if (!frame::decode_header(buf.data() + pos, h) || h.opcode != frame::Opcode::REQUEST ||
+                h.meta_len > frame::MAX_META_BYTES || h.payload_len > frame::MAX_PAYLOAD_BYTES) {
+                LOG_ERROR("Invalid frame header, closing connection");
+                ok = false;
+                break;
+            }
+            pos += frame::HEADER_SIZE;
+            conn->frame_hdr = h;
+            conn->frame_active = true;
+        }
+
+        if (!conn->frame_meta_done) {
+            if (buf.size() - pos < conn->frame_hdr.meta_len) break;
+            conn->frame_args = RequestArgs();
+            const char *meta = buf.data() + pos;
+            if (!parse_request(meta, meta + conn->frame_hdr.meta_len, conn->frame_args, conn->frame_dom)) {
+                LOG_ERROR("Invalid frame metadata, closing connection");
+                ok = false;
+                break;
+            }
+            pos += conn->frame_hdr.meta_len;
+            if (frame_bytes_pending + conn->frame_hdr.payload_len > MAX_PENDING_PAYLOAD) {
+                LOG_ERROR("Frame payload budget exhausted, closing connection");
+                ok = false;
+                break;
+            }
+            frame_bytes_pending += conn->frame_hdr.payload_len;
+            conn->frame_payload.clear();
+            conn->frame_payload.reserve(static_cast<size_t>(std::min<uint64_t>(conn->frame_hdr.payload_len, READ_BUDGET)));
+            conn->frame_filled = 0;
+            conn->frame_meta_done = true;
+        }
+
+        uint64_t want = conn->frame_hdr.payload_len - conn->frame_filled;
+        size_t take = static_cast<size_t>(std::min<uint64_t>(want, buf.size() - pos));
+        if (take > 0) {
+            conn->frame_payload.insert(conn->frame_payload.end(), buf.data() + pos, buf.data() + pos + take);
+            conn->frame_filled += take;
+            pos += take;
+        }
+        if (conn->frame_filled < conn->frame_hdr.payload_len) break; // rest arrives via recv()
+        frame_bytes_pending -= conn->frame_hdr.payload_len;
+
+        Request r;
+        r.args = std::move(conn->frame_args);
+        r.request = std::move(conn->frame_dom);
+        r.conn = conn;
+        r.payload = std::move(conn->frame_payload);
+        conn->frame_dom = json();
+        conn->frame_payload = std::vector<char>();
+        conn->frame_filled = 0;
+        conn->frame_active = false;
+        conn->frame_meta_done = false;
+        enqueue(conn, std::move(r));
+    }
+
+    if (pos > 0) buf.erase(0, pos);
+    return ok;
+}
+
+// Each complete request is numbered and queued; POST bodies are the same
+// JSON objects the line protocol carries. Anything the gateway can answer
+// itself (preflight, bad requests) is answered in sequence from here.
+bool EventLoop::process_http(const std::shared_ptr<Connection> &conn) {
+    std::string &buf = conn->in_buf;
+    size_t pos = 0;
+
+    while (!conn->paused && !conn->http_closing) {
+        http::RequestHead &h = conn->http_head;
+        if (!conn->http_head_done) {
+            http::ParseResult pr = http::parse_head(buf, pos, h);
+            if (pr == http::ParseResult::INCOMPLETE) break;
+            if (pr == http::ParseResult::BAD) {
+                reply_http(conn, 400, R"({"status":"error","error_message":"Malformed HTTP request"})", false);
+                break;
+            }
+            if (h.chunked) {
+                reply_http(conn, 501, R"({"status":"error","error_message":"Chunked bodies are not supported"})", false);
+                break;
+            }
+            if (h.content_length > MAX_LINE_BYTES) {
+                reply_http(conn, 413, R"({"status":"error","error_message":"Request body too large"})", false);
+                break;
+            }
+            conn->http_head_done = true;
+        }
+
+        if (buf.size() - pos < h.head_len + h.content_length) break;
+        size_t body_start = pos + h.head_len;
+        pos = body_start + h.content_length;
+        conn->http_head_done = false;
+
+        if (h.method == "OPTIONS") { reply_http(conn, 204, "", h.keep_alive); continue; }
+        if (h.method != "POST") {
+            reply_http(conn, 405, R"({"status":"error","error_message":"Use POST"})", h.keep_alive);
+            continue;
+        }
+        if (h.target != "/" && h.target != "/api") {
+            reply_http(conn, 404, R"({"status":"error","error_message":"Unknown path"})", h.keep_alive);
+            continue;
+        }
+
+        Request r;
+        if (!parse_request(buf.data() + body_start, buf.data() + pos, r.args, r.request)) {
+            reply_http(conn, 400, R"({"status":"error","error_message":"Invalid JSON"})", h.keep_alive);
+            continue;
+        }
+        r.conn = conn;
+        r.http_seq = conn->http_next_in++;
+        r.http_keep_alive = h.keep_alive;
+        if (!h.keep_alive) conn->http_closing = true;
+        enqueue(conn, std::move(r));
+    }
+
+    if (conn->http_closing) buf.clear(); // anything after the last request is ignored
+    else if (pos > 0) buf.erase(0, pos);
+    return true;
+}
+
+void EventLoop::reply_http(const std::shared_ptr<Connection> &conn, int status, const std::string &body, bool keep_alive) {
+    if (!keep_alive) conn->http_closing = true;
+    send_http_response(conn, conn->http_next_in++, http::build_response(status, body, keep_alive));
+}
+
+void EventLoop::reply_throttled(const std::shared_ptr<Connection> &conn, const Request &r, uint32_t retry_after_ms) {
+    g_server_metrics.requests_throttled++;
+    std::string body = throttled_response(r.args, retry_after_ms).dump();
+    if (conn->protocol == WireProtocol::HTTP) {
+        send_http_response(conn, r.http_seq, http::build_response(429, body, r.http_keep_alive));
+    } else if (conn->protocol == WireProtocol::FRAMED) {
+        send_response(conn, frame::encode(frame::Opcode::RESPONSE, body, 0));
+    } else {
+        body.push_back('\n');
+        send_response(conn, std::move(body));
+    }
+}
+
+// ===================== WRITE =====================
+void EventLoop::send_response(const std::shared_ptr<Connection> &conn, std::string &&data,
+                              std::vector<char> &&payload) {
+    if (conn->closed) return;
+    std::unique_lock<std::mutex> lock(conn->out_mtx);
+    conn->out_bytes += data.size() + payload.size();
+    conn->out_queue.emplace_back(std::move(data));
+    if (!payload.empty()) conn->out_queue.emplace_back(std::move(payload));
+    schedule_flush(conn, lock);
+}
+
+void EventLoop::send_response(const std::shared_ptr<Connection> &conn, std::string &&data,
+                              std::shared_ptr<const std::vector<char>> payload) {
+    if (conn->closed) return;
+    std::unique_lock<std::mutex> lock(conn->out_mtx);
+    conn->out_bytes += data.size() + (payload ? payload->size() : 0);
+    conn->out_queue.emplace_back(std::move(data));
+    if (payload && !payload->empty()) conn->out_queue.emplace_back(std::move(payload));
+    schedule_flush(conn, lock);
+}
+
+void EventLoop::send_http_response(const std::shared_ptr<Connection> &conn, uint64_t seq, std::string &&data) {
+    if (conn->closed) return;
+    std::unique_lock<std::mutex> lock(conn->out_mtx);
+    if (seq != conn->http_next_out) {
+        conn->http_reorder.emplace(seq, std::move(data)); // an earlier request is still running
+        return;
+    }
+    conn->out_bytes += data.size();
+    conn->out_queue.emplace_back(std::move(data));
+    ++conn->http_next_out;
+    for (auto it = conn->http_reorder.begin();
+         it != conn->http_reorder.end() && it->first == conn->http_next_out;
+         it = conn->http_reorder.erase(it)) {
+        conn->out_bytes += it->second.size();
+        conn->out_queue.emplace_back(std::move(it->second));
+        ++conn->http_next_out;
+    }
+    schedule_flush(conn, lock);
+}
+
+// Called with out_mtx held; the first response queued since the last
+// flush puts the connection on the pending list and wakes the loop.
+void EventLoop::schedule_flush(const std::shared_ptr<Connection> &conn, std::unique_lock<std::mutex> &out_lock) {
+    if (conn->flush_scheduled) return;
+    conn->flush_scheduled = true;
+    out_lock.unlock();
+    {
+        std::lock_guard<std::mutex> lock(pending_mtx);
+        pending_flush.push_back(conn);
+    }
+    uint64_t one = 1;
+    ssize_t ignored = write(wake_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+void EventLoop::request_resume() {
+    resume_requested = true;
+    uint64_t one = 1;
+    ssize_t ignored = write(wake_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+void EventLoop::resume_paused() {
+    std::vector<std::shared_ptr<Connection>> waiting;
+    waiting.swap(paused);
+    for (size_t i = 0; i < waiting.size(); ++i) {
+        auto &conn = waiting[i];
+        if (conn->closed) continue;
+        conn->paused = false;
+        if (conn->stalled) {
+            Request r = std::move(*conn->stalled);
+            conn->stalled.reset();
+            push(conn, std::move(r)); // already admitted by the rate limiter
+        }
+        if (!process_input(conn)) { close_connection(conn); continue; }
+        if (conn->paused) {
+            // Still full: everyone not yet resumed keeps waiting too.
+            paused.insert(paused.end(), waiting.begin() + i + 1, waiting.end());
+            return;
+        }
+        handle_readable(conn); // edge-triggered: drain what arrived meanwhile
+    }
+}
+
+void EventLoop::handle_wakeup() {
+    uint64_t count;
+    while (read(wake_fd, &count, sizeof(count)) > 0) {}
+
+    if (resume_requested.exchange(false)) resume_paused();
+
+    std::vector<std::shared_ptr<Connection>> ready;
+    {
+        std::lock_guard<std::mutex> lock(pending_mtx);
+        ready.swap(pending_flush);
+    }
+    for (auto &conn : ready) {
+        std::lock_guard<std::mutex> lock(conn->out_mtx);
+        conn->flush_scheduled = false;
+    }
+    flush_all(ready);
+}
+
+// Points iov at the unsent front of out_queue; returns the entry count and
+// sets more if the queue holds more than MAX_IOV entries.
+int EventLoop::gather_output(const std::shared_ptr<Connection> &conn, iovec *iov, bool &more, size_t &len) {
+    std::lock_guard<std::mutex> lock(conn->out_mtx);
+    int count = 0;
+    more = false;
+    len = 0;
+    size_t offset = conn->out_offset;
+    for (auto it = conn->out_queue.begin(); it != conn->out_queue.end(); ++it) {
+        if (count == MAX_IOV) { more = true; break; }
+        iov[count].iov_base = const_cast<char*>(it->data()) + offset;
+        iov[count].iov_len = it->size() - offset;
+        len += iov[count].iov_len;
+        offset = 0;
+        ++count;
+    }
+    return count;
+}
+
+void EventLoop::consume_output(const std::shared_ptr<Connection> &conn, size_t written) {
+    std::lock_guard<std::mutex> lock(conn->out_mtx);
+    conn->out_bytes -= written;
+    while (written > 0) {
+        size_t left = conn->out_queue.front().size() - conn->out_offset;
+        if (written < left) { conn->out_offset += written; break; }
+        written -= left;
+        conn->out_queue.pop_front();
+        conn->out_offset = 0;
+    }
+}
+
+// "Connection: close" takes effect once every response has gone out.
+void EventLoop::finish_flush(const std::shared_ptr<Connection> &conn) {
+    if (!conn->http_closing || conn->closed) return;
+    bool done;
+    {
+        std::lock_guard<std::mutex> lock(conn->out_mtx);
+        done = conn->out_queue.empty() && conn->http_next_out == conn->http_next_in;
+    }
+    if (done) close_connection(conn);
+}
+
+// Gathers queued responses into writev() calls until the queue is empty or
+// the socket is full. Partial writes just advance out_offset; whatever is
+// left waits for the next EPOLLOUT edge. A backlog that needs more than one
+// writev() is corked so the kernel packs it into full segments.
+void EventLoop::flush(const std::shared_ptr<Connection> &conn) {
+    iovec iov[MAX_IOV];
+    bool corked = false;
+
+    while (true) {
+        bool more;
+        size_t len;
+        int count = gather_output(conn, iov, more, len);
+        if (count == 0) break;
+
+        if (more && !corked) {
+            int on = 1;
+            setsockopt(conn->fd, IPPROTO_TCP, TCP_CORK, &on, sizeof(on));
+            corked = true;
+        }
+
+        ssize_t n = writev(conn->fd, iov, count);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break; // EAGAIN keeps the rest for EPOLLOUT; hard errors surface as EPOLLERR
+        }
+        consume_output(conn, static_cast<size_t>(n));
+    }
+
+    if (corked) {
+        int off = 0;
+        setsockopt(conn->fd, IPPROTO_TCP, TCP_CORK, &off, sizeof(off));
+    }
+    finish_flush(conn);
+}
+
+// Flushes several connections. With io_uring their first writev() calls
+// go to the kernel as one submission; a connection whose backlog did not
+// fit in that write continues through flush().
+void EventLoop::flush_all(const std::vector<std::shared_ptr<Connection>> &conns) {
+    if (!uring || conns.size() < 2) {
+        for (auto &conn : conns) if (!conn->closed) flush(conn);
+        return;
+    }
+
+    struct PendingWrite {
+        std::shared_ptr<Connection> conn;
+        iovec iov[MAX_IOV];
+        int count;
+        bool more;
+        size_t len;
+        int32_t result;
+    };
+    std::vector<PendingWrite> batch(conns.size());
+    size_t prepared = 0;
+    for (auto &conn : conns) {
+        if (conn->closed) continue;
+        PendingWrite &w = batch[prepared];
+        w.count = gather_output(conn, w.iov, w.more, w.len);
+        if (w.count == 0) { finish_flush(conn); continue; }
+        if (!uring->prep_writev(conn->fd, w.iov, w.count, 0, prepared)) { flush(conn); continue; }
+        w.conn = conn;
+        w.result = -EAGAIN;
+        ++prepared;
+    }
+    if (prepared == 0) return;
+
+    if (!uring->submit_and_wait(static_cast<unsigned>(prepared))) {
+        perror("io_uring_enter failed");
+        // Nothing is known to have been written; flush() will redo it.
+        for (size_t i = 0; i < prepared; ++i) flush(batch[i].conn);
+        return;
+    }
+    uint64_t idx;
+    int32_t res;
+    for (size_t seen = 0; seen < prepared && uring->pop_completion(idx, res); ++seen) batch[idx].result = res;
+
+    for (size_t i = 0; i < prepared; ++i) {
+        PendingWrite &w = batch[i];
+        if (w.conn->closed) continue;
+        if (w.result > 0) consume_output(w.conn, static_cast<size_t>(w.result));
+        if (w.result == -EINTR || (w.result > 0 && static_cast<size_t>(w.result) == w.len && w.more))
+            flush(w.conn); // rest of a long backlog
+        else
+            finish_flush(w.conn); // done, or EAGAIN and waiting for EPOLLOUT
+    }
+}
+
+void EventLoop::close_connection(const std::shared_ptr<Connection> &conn) {
+    if (conn->frame_meta_done) {
+        frame_bytes_pending -= conn->frame_hdr.payload_len;
+        conn->frame_meta_done = false;
+    }
+    if (conn->closed.exchange(true)) return;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn->fd, nullptr);
+    connections.erase(conn->fd);
+    close(conn->fd);
+    g_server_metrics.connections_active--;
+
+    std::shared_ptr<ShmChannel> channel;
+    {
+        std::lock_guard<std::mutex> lock(conn->out_mtx);
+        channel = std::move(conn->shm);
+    }
+    if (channel) channel->close();
+}
@@ -1,33 +1,47 @@
 #include "../include/file_ops.hpp"
 #include <algorithm>
 
+// Content buffer that may be modified in place. Callers hold the tree lock
+// exclusively, so nobody can take a new snapshot meanwhile; if an older
+// snapshot is still being sent, the writer gets a private copy instead.
+static std::vector<char>& writable_content(FileEntry &entry) {
+    if (!entry.content) entry.content = std::make_shared<std::vector<char>>();
+    else if (entry.content.use_count() > 1) entry.content = std::make_shared<std::vector<char>>(*entry.content);
+    return *entry.content;
+}
 
 
-OFSErrorCodes FileOperations::file_create(const std::string &path, uint64_t size) {
+OFSErrorCodes FileOperations::file_create(const std::string &path, uint64_t size, uint32_t block) {
     auto [parent, name] = locate_parent(root, path);
     if (!parent) return OFSErrorCodes::ERROR_INVALID_PATH;
     if (parent->files.find(name) != parent->files.end()) return OFSErrorCodes::ERROR_FILE_EXISTS;
 
-    int blk = block_manager->allocate_block();
-    if (blk == -1) return OFSErrorCodes::ERROR_NO_SPACE;
-
-    FileEntry entry(name, EntryType::FILE, size, 0644, "root", blk);
+    FileEntry entry(name, EntryType::FILE, size, 0644, "root", block);
     parent->files[name] = entry;
     (*inode_table)[entry.inode] = entry;
+    ++counts->files;
 
     return OFSErrorCodes::SUCCESS;
 }
 
-OFSErrorCodes FileOperations::file_delete(const std::string &path) {
+OFSErrorCodes FileOperations::check_create(const std::string &path) {
+    auto [parent, name] = locate_parent(root, path);
+    if (!parent) return OFSErrorCodes::ERROR_INVALID_PATH;
+    if (parent->files.find(name) != parent->files.end()) return OFSErrorCodes::ERROR_FILE_EXISTS;
+    return OFSErrorCodes::SUCCESS;
+}
+
+OFSErrorCodes FileOperations::file_delete(const std::string &path, uint32_t &block) {
     auto [parent, name] = locate_parent(root, path);
     if (!parent) return OFSErrorCodes::ERROR_INVALID_PATH;
 
     auto it = parent->files.find(name);
     if (it == parent->files.end()) return OFSErrorCodes::ERROR_NOT_FOUND;
 
-    block_manager->free_block(it->second.inode);
+    block = it->second.inode;
     inode_table->erase(it->second.inode);
     parent->files.erase(it);
+    --counts->files;
 
     return OFSErrorCodes::SUCCESS;
 }
@@ -56,16 +70,15 @@ OFSErrorCodes FileOperations::set_permissions(const std::string &path, uint32_t
 }
 
 FSStats FileOperations::get_stats() {
-    FSStats stats;
-    std::function<void(DirNode*)> dfs = [&](DirNode* node) {
-        stats.total_directories++;
-        stats.total_files += node->files.size();
-        for (auto &c : node->children) dfs(c.second.get());
-    };
-    dfs(root);
-
-    stats.used_space = block_manager->used_blocks() * block_manager->block_size();
-    stats.free_space = block_manager->free_blocks() * block_manager->block_size();
+    SpaceUsage space = block_manager->usage();
+    FSStats stats(space.total_blocks * space.block_size,
+                  (space.total_blocks - space.free_blocks) * space.block_size,
+                  space.free_blocks * space.block_size);
+    stats.total_files = counts->files;
+    stats.total_directories = counts->directories;
+    stats.free_extents = space.free_runs;
+    stats.largest_free_extent = space.largest_free_run;
+    stats.fragmentation = space.fragmentation;
     return stats;
 }
 
@@ -83,8 +96,9 @@ void FileOperations::file_edit(const std::string &path, const std::vector<char>
     if (it == parent->files.end()) return;
 
     FileEntry &entry = it->second;
-    if (entry.content.size() < offset + data.size()) entry.content.resize(offset + data.size());
-    std::copy(data.begin(), data.end(), entry.content.begin() + offset);
+    auto &content = writable_content(entry);
+    if (content.size() < offset + data.size()) content.resize(offset + data.size());
+    std::copy(data.begin(), data.end(), content.begin() + offset);
 }
 
 void FileOperations::file_read(const std::string &path, std::vector<char> &out) {
@@ -92,7 +106,51 @@ void FileOperations::file_read(const std::string &path, std::vector<char> &out)
     if (!parent) return;
     auto it = parent->files.find(name);
     if (it == parent->files.end()) return;
-    out = it->second.content;
+    if (it->second.content) out = *it->second.content;
+    else out.clear();
+}
+
+std::shared_ptr<const std::vector<char>> FileOperations::file_read_shared(const std::string &path) {
+    auto [parent, name] = locate_parent(root, path);
+    if (!parent) return nullptr;
+    auto it = parent->files.find(name);
+    if (it == parent->files.end()) return nullptr;
+    return it->second.content;
+}
+
+OFSErrorCodes FileOperations::file_read_range(const std::string &path, uint64_t offset, size_t max_len,
+                                              std::vector<char> &out, uint64_t &file_size) {
+    auto [parent, name] = locate_parent(root, path);
+    if (!parent) return OFSErrorCodes::ERROR_NOT_FOUND;
+    auto it = parent->files.find(name);
+    if (it == parent->files.end()) return OFSErrorCodes::ERROR_NOT_FOUND;
+
+    const auto &content = it->second.content;
+    file_size = content ? content->size() : 0;
+    out.clear();
+    if (offset >= file_size) return OFSErrorCodes::SUCCESS;
+    size_t n = static_cast<size_t>(std::min<uint64_t>(max_len, file_size - offset));
+    out.assign(content->begin() + offset, content->begin() + offset + n);
+    return OFSErrorCodes::SUCCESS;
+}
+
+OFSErrorCodes FileOperations::file_write_range(const std::string &path, uint64_t offset, const char *data, size_t len,
+                                               bool last, uint64_t &file_size) {
+    auto [parent, name] = locate_parent(root, path);
+    if (!parent) return OFSErrorCodes::ERROR_NOT_FOUND;
+    auto it = parent->files.find(name);
+    if (it == parent->files.end()) return OFSErrorCodes::ERROR_NOT_FOUND;
+
+    FileEntry &entry = it->second;
+    uint64_t current = entry.content ? entry.content->size() : 0;
+    if (offset > current) return OFSErrorCodes::ERROR_INVALID_OPERATION; // no holes
+
+    auto &content = writable_content(entry);
+    size_t end = static_cast<size_t>(offset) + len;
+    if (last || content.size() < end) content.resize(end);
+    std::copy(data, data + len, content.begin() + offset);
+    file_size = content.size();
+    return OFSErrorCodes::SUCCESS;
 }
 
 void FileOperations::file_truncate(const std::string &path, size_t new_size) {
@@ -100,7 +158,7 @@ void FileOperations::file_truncate(const std::string &path, size_t new_size) {
     if (!parent) return;
     auto it = parent->files.find(name);
     if (it == parent->files.end()) return;
-    it->second.content.resize(new_size);
+    writable_content(it->second).resize(new_size);
 }
 
 void FileOperations::file_rename(const std::string &old_path, const std::string &new_path) {
@@ -120,7 +178,9 @@ void FileOperations::file_rename(const std::string &old_path, const std::string
     std::strncpy(entry.name, name_new.c_str(), sizeof(entry.name) - 1);
     entry.name[sizeof(entry.name) - 1] = '\0';  // Ensure null-termination
 
-    // Insert into the new parent and erase from the old parent
+    // Insert into the new parent and erase from the old parent. A file
+    // already at new_path is replaced, one fewer in total.
+    if (parent_new->files.count(name_new)) --counts->files;
     parent_new->files[name_new] = entry;
     parent_old->files.erase(it);
 }
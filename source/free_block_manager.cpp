@@ -1,55 +1,422 @@
 #include "../include/free_block_manager.hpp"
 #include <algorithm>
 
+static inline uint64_t bit(uint64_t i) { return 1ULL << (i & 63); }
+
+// ---------- one allocation group ----------
+void FreeBlockManager::Group::reset(const std::vector<bool> *bits) {
+    if (bits) {
+        levels.assign(1, std::vector<uint64_t>(static_cast<size_t>((count + 63) / 64), 0));
+        uint64_t n = 0;
+        for (uint64_t i = 0; i < count; ++i)
+            if ((*bits)[base + i]) { levels[0][i / 64] |= bit(i); ++n; }
+        free_count.store(n, std::memory_order_relaxed);
+    } else {
+        levels.assign(1, std::vector<uint64_t>(static_cast<size_t>((count + 63) / 64), ~0ULL));
+        if (count % 64) levels[0].back() = bit(count) - 1;
+        free_count.store(count, std::memory_order_relaxed);
+    }
+    build_summaries();
+    build_run_index();
+}
+
+// Rebuilds every summary level from levels[0].
+void FreeBlockManager::Group::build_summaries() {
+    levels.resize(1);
+    while (levels.back().size() > 1) {
+        const std::vector<uint64_t> &below = levels.back();
+        std::vector<uint64_t> up((below.size() + 63) / 64, 0);
+        for (size_t i = 0; i < below.size(); ++i)
+            if (below[i]) up[i / 64] |= bit(i);
+        levels.push_back(std::move(up));
+    }
+}
+
+int64_t FreeBlockManager::Group::find_free() const {
+    if (levels.empty() || levels[0].empty() || levels.back()[0] == 0) return -1;
+    uint64_t idx = 0;
+    for (size_t k = levels.size(); k-- > 0;)
+        idx = idx * 64 + __builtin_ctzll(levels[k][idx]);
+    return static_cast<int64_t>(idx);
+}
+
+bool FreeBlockManager::Group::is_free(uint64_t local) const {
+    return levels[0][local / 64] & bit(local);
+}
+
+// A word that becomes empty clears its bit one level up, and so on.
+void FreeBlockManager::Group::clear_bits(uint64_t word, uint64_t mask) {
+    free_count.fetch_sub(__builtin_popcountll(mask), std::memory_order_relaxed);
+    for (size_t k = 0; k < levels.size(); ++k) {
+        uint64_t &w = levels[k][word];
+        w &= ~mask;
+        if (w) return;
+        mask = bit(word);
+        word /= 64;
+    }
+}
+
+// A word that stops being empty sets its bit one level up, and so on.
+void FreeBlockManager::Group::set_bits(uint64_t word, uint64_t mask) {
+    free_count.fetch_add(__builtin_popcountll(mask), std::memory_order_relaxed);
+    for (size_t k = 0; k < levels.size(); ++k) {
+        uint64_t &w = levels[k][word];
+        bool was_empty = w == 0;
+        w |= mask;
+        if (!was_empty) return;
+        mask = bit(word);
+        word /= 64;
+    }
+}
+
+void FreeBlockManager::Group::mark_used(uint64_t start, uint64_t length) {
+    for (uint64_t i = start, end = start + length; i < end;) {
+        uint64_t stop = std::min(end, (i / 64 + 1) * 64);
+        uint64_t n = stop - i;
+        uint64_t mask = (n == 64 ? ~0ULL : (1ULL << n) - 1) << (i & 63);
+        clear_bits(i / 64, mask);
+        i = stop;
+    }
+}
+
+void FreeBlockManager::Group::mark_free(uint64_t start, uint64_t length) {
+    for (uint64_t i = start, end = start + length; i < end;) {
+        uint64_t stop = std::min(end, (i / 64 + 1) * 64);
+        uint64_t n = stop - i;
+        uint64_t mask = (n == 64 ? ~0ULL : (1ULL << n) - 1) << (i & 63);
+        set_bits(i / 64, mask);
+        i = stop;
+    }
+}
+
+bool FreeBlockManager::Group::range_in_use(uint64_t start, uint64_t length) const {
+    for (uint64_t i = start, end = start + length; i < end;) {
+        uint64_t stop = std::min(end, (i / 64 + 1) * 64);
+        uint64_t n = stop - i;
+        uint64_t mask = (n == 64 ? ~0ULL : (1ULL << n) - 1) << (i & 63);
+        if (levels[0][i / 64] & mask) return false;
+        i = stop;
+    }
+    return true;
+}
+
+// ---------- free-run index ----------
+void FreeBlockManager::Group::add_run(uint64_t start, uint64_t length) {
+    runs_by_start.emplace(start, length);
+    runs_by_length.emplace(length, start);
+}
+
+void FreeBlockManager::Group::remove_run(std::map<uint64_t, uint64_t>::iterator it) {
+    runs_by_length.erase({it->second, it->first});
+    runs_by_start.erase(it);
+}
+
+// Cuts [start, start + length) out of the run holding it.
+void FreeBlockManager::Group::take_from_runs(uint64_t start, uint64_t length) {
+    auto it = std::prev(runs_by_start.upper_bound(start));
+    uint64_t run_start = it->first, run_end = it->first + it->second;
+    remove_run(it);
+    if (start > run_start) add_run(run_start, start - run_start);
+    if (start + length < run_end) add_run(start + length, run_end - start - length);
+    publish_runs();
+}
+
+// Adds [start, start + length) back, merged with the runs it touches.
+void FreeBlockManager::Group::return_to_runs(uint64_t start, uint64_t length) {
+    uint64_t end = start + length;
+    auto right = runs_by_start.find(end);
+    if (right != runs_by_start.end()) {
+        end += right->second;
+        remove_run(right);
+    }
+    auto left = runs_by_start.lower_bound(start);
+    if (left != runs_by_start.begin()) {
+        --left;
+        if (left->first + left->second == start) {
+            start = left->first;
+            remove_run(left);
+        }
+    }
+    add_run(start, end - start);
+    publish_runs();
+}
+
+void FreeBlockManager::Group::publish_runs() {
+    run_count.store(runs_by_start.size(), std::memory_order_relaxed);
+    longest_run.store(runs_by_length.empty() ? 0 : runs_by_length.rbegin()->first, std::memory_order_relaxed);
+}
+
+void FreeBlockManager::Group::build_run_index() {
+    runs_by_start.clear();
+    runs_by_length.clear();
+    next_fit_cursor = 0;
+    bool in_run = false;
+    uint64_t run_start = 0;
+    const std::vector<uint64_t> &words = levels[0];
+    for (size_t w = 0; w < words.size(); ++w) {
+        if (words[w] == (in_run ? ~0ULL : 0)) continue;   // whole word continues the current state
+        for (uint64_t b = 0; b < 64; ++b) {
+            bool free = words[w] & (1ULL << b);
+            if (free == in_run) continue;
+            uint64_t i = w * 64 + b;
+            if (free) run_start = i;
+            else add_run(run_start, i - run_start);
+            in_run = free;
+        }
+    }
+    if (in_run) add_run(run_start, count - run_start);
+    publish_runs();
+}
+
+// Takes whole runs of free bits a word at a time.
+size_t FreeBlockManager::Group::take(size_t n, std::vector<uint64_t> &out) {
+    size_t taken_total = 0;
+    while (taken_total < n) {
+        int64_t first = find_free();
+        if (first < 0) break;
+        uint64_t word = static_cast<uint64_t>(first) / 64;
+        uint64_t avail = levels[0][word];
+        uint64_t taken = 0;
+        while (avail && taken_total < n) {
+            uint64_t b = __builtin_ctzll(avail);
+            out.push_back(base + word * 64 + b);
+            taken |= 1ULL << b;
+            avail &= avail - 1;
+            take_from_runs(word * 64 + b, 1);
+            ++taken_total;
+        }
+        clear_bits(word, taken);
+    }
+    return taken_total;
+}
+
+void FreeBlockManager::Group::release(uint64_t local) {
+    if (is_free(local)) return;
+    set_bits(local / 64, bit(local));
+    return_to_runs(local, 1);
+}
+
+bool FreeBlockManager::Group::take_extent(uint64_t min_len, uint64_t max_len, Extent &out, ExtentPolicy policy) {
+    if (runs_by_start.empty()) return false;
+
+    uint64_t start = 0, length = 0;
+    if (policy == ExtentPolicy::BEST_FIT) {
+        // Smallest run holding max_len; failing that, all of the largest run.
+        auto fit = runs_by_length.lower_bound({max_len, 0});
+        if (fit == runs_by_length.end()) fit = std::prev(runs_by_length.end());
+        if (fit->first < min_len) return false;
+        start = fit->second;
+        length = std::min(fit->first, max_len);
+    } else {
+        // First run of at least min_len at or after the cursor, wrapping once.
+        auto it = runs_by_start.lower_bound(next_fit_cursor);
+        for (size_t seen = 0; seen < runs_by_start.size(); ++seen, ++it) {
+            if (it == runs_by_start.end()) it = runs_by_start.begin();
+            if (it->second >= min_len) break;
+        }
+        if (it == runs_by_start.end() || it->second < min_len) return false;
+        start = it->first;
+        length = std::min(it->second, max_len);
+    }
+
+    mark_used(start, length);
+    take_from_runs(start, length);
+    next_fit_cursor = start + length;
+    out.start = base + start;
+    out.length = length;
+    return true;
+}
+
+// ---------- the container ----------
+void FreeBlockManager::set_group_count(unsigned n) {
+    wanted_groups = std::max(1u, n);
+}
+
+// Every group but the last spans the same whole number of bitmap words.
+void FreeBlockManager::build_groups(uint64_t total_blocks, const std::vector<bool> *bits) {
+    uint64_t n = std::max<uint64_t>(1, std::min<uint64_t>(wanted_groups, total_blocks / MIN_GROUP_BLOCKS));
+    group_span = std::max<uint64_t>(1, ((total_blocks + n - 1) / n + 63) / 64) * 64;
+    block_count = total_blocks;
+    groups.clear();
+    for (uint64_t base = 0; base < total_blocks; base += group_span) {
+        auto g = std::make_unique<Group>();
+        g->base = base;
+        g->count = std::min(group_span, total_blocks - base);
+        g->reset(bits);
+        groups.push_back(std::move(g));
+    }
+}
+
+// Threads take home groups round-robin in the order they first allocate.
+size_t FreeBlockManager::home_group() const {
+    static std::atomic<unsigned> next_home{0};
+    thread_local unsigned home = next_home.fetch_add(1, std::memory_order_relaxed);
+    return home % groups.size();
+}
+
 void FreeBlockManager::init(uint64_t total_blocks, uint64_t block_size) {
-    blocks.assign(static_cast<size_t>(total_blocks), true);
     block_size_bytes = block_size;
+    build_groups(total_blocks, nullptr);
 }
 
 int FreeBlockManager::allocate_block() {
-    for (size_t i = 0; i < blocks.size(); ++i) {
-        if (blocks[i]) {
-            blocks[i] = false;
-            return static_cast<int>(i);
-        }
+    size_t n = groups.size();
+    if (n == 0) return -1;
+    size_t home = home_group();
+    for (size_t k = 0; k < n; ++k) {
+        Group &g = *groups[(home + k) % n];
+        if (g.free_count.load(std::memory_order_relaxed) == 0) continue;
+        std::lock_guard<std::mutex> lock(g.mtx);
+        int64_t idx = g.find_free();
+        if (idx < 0) continue;
+        g.clear_bits(idx / 64, bit(idx));
+        g.take_from_runs(idx, 1);
+        return static_cast<int>(g.base + idx);
     }
     return -1;
 }
 
 bool FreeBlockManager::free_block(uint64_t index) {
-    if (index >= blocks.size()) return false;
-    blocks[index] = true;
+    if (index >= block_count) return false;
+    Group &g = group_of(index);
+    std::lock_guard<std::mutex> lock(g.mtx);
+    g.release(index - g.base);
     return true;
 }
 
 bool FreeBlockManager::is_free(uint64_t index) const {
-    if (index >= blocks.size()) return false;
-    return blocks[index];
+    if (index >= block_count) return false;
+    Group &g = group_of(index);
+    std::lock_guard<std::mutex> lock(g.mtx);
+    return g.is_free(index - g.base);
+}
+
+// Group by group from home; a shortfall puts back what was taken.
+bool FreeBlockManager::allocate_n(size_t n, std::vector<uint64_t> &out) {
+    if (n > free_blocks()) return false;
+    size_t start = out.size();
+    size_t count = groups.size();
+    size_t home = count ? home_group() : 0;
+    for (size_t k = 0; k < count && out.size() - start < n; ++k) {
+        Group &g = *groups[(home + k) % count];
+        if (g.free_count.load(std::memory_order_relaxed) == 0) continue;
+        std::lock_guard<std::mutex> lock(g.mtx);
+        g.take(n - (out.size() - start), out);
+    }
+    if (out.size() - start == n) return true;
+
+    std::vector<uint64_t> taken(out.begin() + start, out.end());
+    out.resize(start);
+    free_n(taken);
+    return false;
+}
+
+// Consecutive indices in the same group share one lock acquisition.
+bool FreeBlockManager::free_n(const std::vector<uint64_t> &indices) {
+    bool ok = true;
+    std::unique_lock<std::mutex> lock;
+    Group *locked = nullptr;
+    for (uint64_t index : indices) {
+        if (index >= block_count) { ok = false; continue; }
+        Group &g = group_of(index);
+        if (&g != locked) {
+            lock = std::unique_lock<std::mutex>(g.mtx);
+            locked = &g;
+        }
+        g.release(index - g.base);
+    }
+    return ok;
+}
+
+bool FreeBlockManager::allocate_extent(uint64_t min_len, uint64_t max_len, Extent &out, ExtentPolicy policy) {
+    if (min_len == 0 || min_len > max_len) return false;
+    size_t n = groups.size();
+    if (n == 0) return false;
+    size_t home = home_group();
+    for (size_t k = 0; k < n; ++k) {
+        Group &g = *groups[(home + k) % n];
+        if (g.free_count.load(std::memory_order_relaxed) < min_len) continue;
+        std::lock_guard<std::mutex> lock(g.mtx);
+        if (g.take_extent(min_len, max_len, out, policy)) return true;
+    }
+    return false;
+}
+
+// The range may cross groups; their locks are taken in ascending order and
+// held until every piece has been checked and freed.
+bool FreeBlockManager::free_extent(uint64_t start, uint64_t length) {
+    if (length == 0 || start >= block_count || length > block_count - start) return false;
+    uint64_t end = start + length;
+    size_t first = start / group_span, last = (end - 1) / group_span;
+
+    std::vector<std::unique_lock<std::mutex>> locks;
+    for (size_t i = first; i <= last; ++i) locks.emplace_back(groups[i]->mtx);
+
+    // The part of the range inside group i, in that group's positions.
+    auto piece = [&](size_t i, uint64_t &from, uint64_t &len) {
+        const Group &g = *groups[i];
+        uint64_t lo = std::max(start, g.base), hi = std::min(end, g.base + g.count);
+        from = lo - g.base;
+        len = hi - lo;
+    };
+    uint64_t from, len;
+    for (size_t i = first; i <= last; ++i) {
+        piece(i, from, len);
+        if (!groups[i]->range_in_use(from, len)) return false;
+    }
+    for (size_t i = first; i <= last; ++i) {
+        piece(i, from, len);
+        groups[i]->mark_free(from, len);
+        groups[i]->return_to_runs(from, len);
+    }
+    return true;
 }
 
 uint64_t FreeBlockManager::total_blocks() const {
-    return blocks.size();
+    return block_count;
 }
 
 uint64_t FreeBlockManager::used_blocks() const {
-    uint64_t used = 0;
-    for (bool b : blocks) if (!b) ++used;
-    return used;
+    return block_count - free_blocks();
 }
 
 uint64_t FreeBlockManager::free_blocks() const {
-    return total_blocks() - used_blocks();
+    uint64_t n = 0;
+    for (auto &g : groups) n += g->free_count.load(std::memory_order_relaxed);
+    return n;
 }
 
 uint64_t FreeBlockManager::block_size() const {
     return block_size_bytes;
 }
 
+SpaceUsage FreeBlockManager::usage() const {
+    SpaceUsage u;
+    u.total_blocks = block_count;
+    u.block_size = block_size_bytes;
+    uint64_t in_longest = 0;   // blocks in the longest run of each group
+    for (auto &g : groups) {
+        u.free_blocks += g->free_count.load(std::memory_order_relaxed);
+        u.free_runs += g->run_count.load(std::memory_order_relaxed);
+        uint64_t longest = g->longest_run.load(std::memory_order_relaxed);
+        u.largest_free_run = std::max(u.largest_free_run, longest);
+        in_longest += longest;
+    }
+    if (u.free_blocks > in_longest) u.fragmentation = 1.0 - static_cast<double>(in_longest) / u.free_blocks;
+    return u;
+}
+
 std::vector<bool> FreeBlockManager::to_vector_bool() const {
-    return blocks;
+    std::vector<bool> bits(static_cast<size_t>(block_count));
+    for (auto &g : groups) {
+        std::lock_guard<std::mutex> lock(g->mtx);
+        for (uint64_t i = 0; i < g->count; ++i)
+            bits[g->base + i] = g->is_free(i);
+    }
+    return bits;
 }
 
 void FreeBlockManager::load_from_vector_bool(const std::vector<bool>& bits, uint64_t block_size) {
-    blocks = bits;             // assign bits to the actual member
     block_size_bytes = block_size; // assign block_size to correct member
+    build_groups(bits.size(), &bits);
 }
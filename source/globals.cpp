@@ -7,3 +7,4 @@ DirectoryTree* g_dir_tree = nullptr;
 std::string g_omni_file = "data/filesystem.omni";
 std::atomic<bool> g_shutdown_flag{false};
 OMNIHeader g_header;
+ServerMetrics g_server_metrics;
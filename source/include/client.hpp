@@ -0,0 +1,108 @@
+#ifndef CLIENT_HPP
+#define CLIENT_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <unordered_map>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include "nlohmann/json.hpp"
+using json = nlohmann::json;
+
+struct ClientOptions {
+    std::string host = "127.0.0.1";
+    uint16_t port = 1010;
+    std::string unix_socket_path;   // set to connect over the unix socket instead
+    size_t pool_size = 1;           // connections; requests go to the least busy one
+    int request_timeout_ms = 30000; // requests fail with a timeout after this; 0 = wait forever
+    int reconnect_min_ms = 50;      // backoff between reconnect attempts...
+    int reconnect_max_ms = 5000;    // ...doubling up to this
+};
+
+// Completion callback. Runs on the I/O thread of the connection that
+// carried the request, so it should hand work off rather than block, and
+// must not wait for another response itself.
+using ResponseCallback = std::function<void(const json &response)>;
+
+// Client for the JSON line protocol. Requests are pipelined: any number
+// may be in flight on a connection and responses are matched back by
+// request_id, so the server is free to answer them out of order. Each
+// request gets an id of its own on the wire; the caller's request_id, if
+// any, is put back into the response.
+//
+// A connection that drops fails its pending requests with an
+// ERROR_IO_ERROR response and is reopened in the background; sessions
+// live on the server, so they survive the reconnect. A request left
+// unanswered for request_timeout_ms fails the same way, and a reply that
+// turns up after that is dropped.
+class OFSClient {
+private:
+    struct Pending {
+        ResponseCallback callback;
+        json request_id;            // the caller's, restored in the response
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    struct PoolConnection {
+        size_t index = 0;
+        int fd = -1;                // guarded by write_mtx
+        std::mutex write_mtx;
+        std::mutex pending_mtx;
+        std::unordered_map<uint64_t, Pending> pending; // guarded by pending_mtx
+        std::atomic<size_t> in_flight{0};
+        std::atomic<bool> up{false};
+        std::thread reader;
+    };
+
+    ClientOptions options;
+    std::vector<std::unique_ptr<PoolConnection>> pool;
+    std::atomic<uint64_t> next_id{1};
+    std::atomic<bool> stopping{false};
+    std::mutex wait_mtx;             // wakes readers sleeping between reconnects
+    std::condition_variable wait_cv;
+
+    std::mutex session_mtx;
+    std::string session_id;          // guarded by session_mtx
+
+    int open_socket(std::string &error_msg) const;
+    bool reconnect(PoolConnection &c, std::string &error_msg);
+    void drop(PoolConnection &c, int fd);
+    void fail_pending(PoolConnection &c, const std::string &reason);
+    void expire_pending(PoolConnection &c);
+    void reader_loop(PoolConnection &c);
+    void dispatch(PoolConnection &c, const char *line, size_t len);
+    PoolConnection* pick();
+
+public:
+    explicit OFSClient(ClientOptions opts = ClientOptions());
+    ~OFSClient();
+    OFSClient(const OFSClient&) = delete;
+    OFSClient& operator=(const OFSClient&) = delete;
+
+    // Opens the pool. Fails only if no connection at all can be made;
+    // the others keep retrying in the background.
+    bool connect(std::string &error_msg);
+    void close();
+
+    // Sends without waiting. Requests without a session_id get the one
+    // from login(). The callback is always called exactly once, with a
+    // timeout error if no response comes within request_timeout_ms.
+    void send_async(json request, ResponseCallback callback);
+
+    // Sends and waits for the response (or a timeout error).
+    json call(json request);
+
+    // Logs in and remembers the session for later requests.
+    bool login(const std::string &username, const std::string &password, std::string &error_msg);
+    std::string session();
+
+    size_t in_flight() const; // requests sent and not yet answered
+};
+
+#endif
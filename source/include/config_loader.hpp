@@ -20,8 +20,25 @@ struct Config {
 
     // [server]
     uint16_t port = 0;
+    uint16_t http_port = 0;        // 0 = no HTTP gateway
+    std::string unix_socket_path;  // empty = no unix socket
     uint32_t max_connections = 0;
     uint32_t queue_timeout = 0;
+    uint32_t io_threads = 0;       // event loops; 0 = one per core
+    std::string io_backend = "auto"; // auto | io_uring | posix
+    uint32_t worker_threads = 0;   // 0 = one per core
+    uint32_t bulk_workers = 0;     // workers reserved for file contents; 0 = shared
+    uint32_t queue_capacity = 1024;
+    uint32_t allocation_groups = 0; // 0 = one per general (non-bulk) worker
+
+    // [limits] requests per second per operation class; 0 = unlimited
+    uint32_t session_rate_control = 0;
+    uint32_t session_rate_metadata = 0;
+    uint32_t session_rate_bulk = 0;
+    uint32_t connection_rate_control = 0;
+    uint32_t connection_rate_metadata = 0;
+    uint32_t connection_rate_bulk = 0;
+    double burst_seconds = 1.0;    // bucket size, in seconds of the rate
 
     // Metadata
     std::string sha256_hash;
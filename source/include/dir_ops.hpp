@@ -4,14 +4,16 @@
 #include "../include/odf_types.hpp"
 #include "dir_tree.hpp"
 #include "path_resolver.hpp"
+#include <functional>
 
 class DirOperations {
 private:
     DirNode* root;
     PathResolver* resolver;
+    TreeCounts* counts;
 
 public:
-    DirOperations(DirNode* root_node) : root(root_node) {
+    DirOperations(DirNode* root_node, TreeCounts* counts_) : root(root_node), counts(counts_) {
         resolver = new PathResolver(root);
     }
     ~DirOperations() { delete resolver; }
@@ -20,6 +22,9 @@ public:
     OFSErrorCodes dir_delete(const std::string &path);
     bool dir_exists(const std::string &path);
     std::vector<std::string> dir_list(const std::string &path);
+    // Calls visit(name, is_dir) for every entry without collecting them;
+    // false if path is not a directory.
+    bool dir_list(const std::string &path, const std::function<void(const std::string &, bool)> &visit);
 };
 
 #endif
@@ -7,6 +7,10 @@
 #include <memory>
 #include <vector>
 #include <sstream>
+#include <shared_mutex>
+#include <mutex>
+#include <string_view>
+#include <memory_resource>
 
 struct DirNode {
     FileEntry entry;
@@ -17,14 +21,30 @@ struct DirNode {
     DirNode(const FileEntry &e) : entry(e) {}
 };
 
+// Entry totals for the whole tree. Whoever adds or removes entries keeps
+// them in step while holding the tree lock exclusively, so stats read two
+// numbers instead of walking the tree.
+struct TreeCounts {
+    uint32_t files = 0;
+    uint32_t directories = 1;   // the root
+};
+
 std::pair<DirNode*, std::string> locate_parent(DirNode* root, const std::string &path);
 class DirectoryTree {
 private:
     std::unique_ptr<DirNode> root;
+    mutable std::shared_mutex tree_mtx;
+    TreeCounts counts;
 
 public:
     DirectoryTree();
     DirNode* get_root() const;
+
+    // Readers of the tree (and of the DirNodes reachable from get_root())
+    // hold this shared; anything that adds, removes or edits entries holds
+    // it exclusively.
+    std::shared_mutex& mutex() const { return tree_mtx; }
+    TreeCounts* entry_counts() { return &counts; }
     DirNode* add_directory(const std::string &path, const FileEntry &entry);
     bool add_file(const std::string &dir_path, const FileEntry &file_entry);
   // dir_tree.hpp (add near other declarations)
@@ -33,12 +53,14 @@ public:
 
     DirNode* find_directory(const std::string &path);
 
-    // Optional: helper to count files/directories
+    // Totals from entry_counts(); same locking as the tree
     size_t count_files();
     size_t count_directories();
 };
 
-// Utility to split path
-std::vector<std::string> split_path(const std::string &path);
+// Utility to split path. The parts point into path and the vector lives in
+// the current request's arena (request_arena.hpp), so neither may outlive
+// the request or path.
+std::pmr::vector<std::string_view> split_path(const std::string &path);
 
 #endif
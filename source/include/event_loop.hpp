@@ -0,0 +1,192 @@
+#ifndef EVENT_LOOP_HPP
+#define EVENT_LOOP_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <deque>
+#include <optional>
+#include <map>
+#include "request_queue.hpp"
+#include "frame_protocol.hpp"
+#include "http_protocol.hpp"
+#include "io_backend.hpp"
+#include "rate_limiter.hpp"
+
+class EventLoop;
+class ShmChannel;
+
+// Chosen per connection from its first bytes: newline-delimited JSON, or
+// length-prefixed frames (see frame_protocol.hpp). Connections accepted on
+// the HTTP listener speak HTTP/1.1 from the start; SHM connections belong
+// to a shared-memory channel rather than a socket.
+enum class WireProtocol : uint8_t {
+    UNKNOWN,
+    LINE,
+    FRAMED,
+    HTTP,
+    SHM
+};
+
+// One queued piece of output: either an encoded response or a raw
+// payload that is handed to writev() as-is. A shared payload is a file
+// content snapshot, sent straight from the file's own buffer.
+struct OutChunk {
+    std::string text;
+    std::vector<char> bytes;
+    std::shared_ptr<const std::vector<char>> shared;
+
+    OutChunk(std::string &&t) : text(std::move(t)) {}
+    OutChunk(std::vector<char> &&b) : bytes(std::move(b)) {}
+    OutChunk(std::shared_ptr<const std::vector<char>> s) : shared(std::move(s)) {}
+
+    const char* data() const { return shared ? shared->data() : !bytes.empty() ? bytes.data() : text.data(); }
+    size_t size() const { return shared ? shared->size() : !bytes.empty() ? bytes.size() : text.size(); }
+};
+
+// One accepted client socket. The input buffer is only touched by the
+// owning loop thread. Workers append finished responses to out_queue; only
+// the loop pops from it, so the front entries stay put while a writev()
+// is in flight without holding out_mtx.
+struct Connection {
+    int fd = -1;
+    EventLoop* loop = nullptr;    // null for SHM connections
+    bool local = false;           // accepted on the unix socket
+    std::string in_buf;
+    WireProtocol protocol = WireProtocol::UNKNOWN;
+    bool paused = false;          // reading stopped until the queue drains
+    bool read_pending = false;    // on the loop's unread list
+    std::optional<Request> stalled; // parsed, but refused by the full queue
+
+    // Framed request being assembled. Once its metadata is parsed the
+    // payload is received straight into frame_payload, which grows as the
+    // bytes arrive rather than to the declared length up front.
+    bool frame_active = false;
+    bool frame_meta_done = false;
+    frame::Header frame_hdr;
+    RequestArgs frame_args;
+    json frame_dom;
+    std::vector<char> frame_payload;
+    size_t frame_filled = 0;
+
+    // HTTP requests are numbered as they are parsed. Workers may finish them
+    // in any order, so a response waits in http_reorder until every earlier
+    // one has been queued.
+    bool http_head_done = false;
+    http::RequestHead http_head;
+    uint64_t http_next_in = 0;
+    bool http_closing = false;     // no more requests; close once answered
+
+    std::mutex out_mtx;
+    std::deque<OutChunk> out_queue; // guarded by out_mtx
+    size_t out_offset = 0;        // bytes of out_queue.front() already sent
+    size_t out_bytes = 0;         // unsent bytes in out_queue
+    bool flush_scheduled = false; // guarded by out_mtx
+    uint64_t http_next_out = 0;   // guarded by out_mtx
+    std::map<uint64_t, std::string> http_reorder; // guarded by out_mtx
+
+    // SHM connections: the channel responses go to. Unix connections: the
+    // channel they attached, closed along with them. Guarded by out_mtx.
+    std::shared_ptr<ShmChannel> shm;
+
+    // Rate limiter buckets; only the thread reading the connection uses them.
+    LaneBuckets limits;
+
+    std::atomic<bool> closed{false};
+};
+
+// Edge-triggered epoll reactor that owns its listening sockets and every
+// client socket accepted on them; the server runs one per core and a
+// connection stays on the loop that accepted it. Complete requests are
+// parsed and pushed to the shared RequestQueue; workers hand responses
+// back through send_response().
+class EventLoop {
+private:
+    RequestQueue &queue;
+    uint32_t max_connections;     // 0 = unlimited
+    int epoll_fd = -1;
+    int wake_fd = -1;   // eventfd used by workers to wake the loop
+
+    struct Listener {
+        int fd;
+        WireProtocol protocol; // UNKNOWN = detect from the first bytes
+        bool local;            // AF_UNIX
+    };
+    std::vector<Listener> listeners;
+    std::unique_ptr<IoUring> uring; // batches socket writes when io_uring is active
+
+    std::unordered_map<int, std::shared_ptr<Connection>> connections;
+    std::vector<std::shared_ptr<Connection>> paused;
+    // Connections that used up READ_BUDGET with bytes still in the socket.
+    // Edge-triggered epoll will not report them again, so the loop reads
+    // them once more on its next pass.
+    std::vector<std::shared_ptr<Connection>> unread;
+    // Payload bytes declared by frames this loop is still receiving.
+    uint64_t frame_bytes_pending = 0;
+
+    std::atomic<bool> resume_requested{false};
+
+    std::mutex pending_mtx;
+    std::vector<std::shared_ptr<Connection>> pending_flush; // guarded by pending_mtx
+
+    void handle_accept(const Listener &listener);
+    void handle_readable(const std::shared_ptr<Connection> &conn);
+    void read_unread();
+    void handle_wakeup();
+    void resume_paused();
+    void reject_connection(int fd, WireProtocol protocol);
+    bool process_input(const std::shared_ptr<Connection> &conn);
+    bool process_lines(const std::shared_ptr<Connection> &conn);
+    bool process_frames(const std::shared_ptr<Connection> &conn);
+    bool process_http(const std::shared_ptr<Connection> &conn);
+    void reply_http(const std::shared_ptr<Connection> &conn, int status, const std::string &body, bool keep_alive);
+    bool enqueue(const std::shared_ptr<Connection> &conn, Request &&r);
+    bool push(const std::shared_ptr<Connection> &conn, Request &&r);
+    void reply_throttled(const std::shared_ptr<Connection> &conn, const Request &r, uint32_t retry_after_ms);
+    int gather_output(const std::shared_ptr<Connection> &conn, iovec *iov, bool &more, size_t &len);
+    void consume_output(const std::shared_ptr<Connection> &conn, size_t written);
+    void finish_flush(const std::shared_ptr<Connection> &conn);
+    void flush(const std::shared_ptr<Connection> &conn);
+    void flush_all(const std::vector<std::shared_ptr<Connection>> &conns);
+    void schedule_flush(const std::shared_ptr<Connection> &conn, std::unique_lock<std::mutex> &out_lock);
+    void close_connection(const std::shared_ptr<Connection> &conn);
+
+public:
+    static constexpr size_t MAX_LINE_BYTES = 64 * 1024 * 1024;
+    static constexpr int MAX_IOV = 64; // responses gathered per writev()
+    static constexpr size_t READ_BUDGET = 256 * 1024; // bytes read from one connection per pass
+    // Cap on frame_bytes_pending; a frame that would pass it closes its
+    // connection, so idle clients cannot declare gigabytes of payload.
+    static constexpr uint64_t MAX_PENDING_PAYLOAD = 1024ULL * 1024 * 1024;
+
+    EventLoop(RequestQueue &q, uint32_t max_conns) : queue(q), max_connections(max_conns) {}
+    ~EventLoop();
+
+    bool init(std::string &error_msg);
+    // Takes a listening socket; protocol is WireProtocol::UNKNOWN for the
+    // JSON/frame ports or WireProtocol::HTTP for the gateway, and local
+    // marks the unix socket.
+    bool add_listener(int listen_socket, WireProtocol protocol, bool local, std::string &error_msg);
+    void run(); // returns when g_shutdown_flag is set
+
+    // Thread-safe: queue bytes for the client and wake the loop to send them.
+    // A non-empty payload is sent right after data without being copied.
+    void send_response(const std::shared_ptr<Connection> &conn, std::string &&data,
+                       std::vector<char> &&payload = {});
+    void send_response(const std::shared_ptr<Connection> &conn, std::string &&data,
+                       std::shared_ptr<const std::vector<char>> payload);
+
+    // Thread-safe: queue a complete HTTP response; it is sent once the
+    // responses to all earlier requests on the connection have been.
+    void send_http_response(const std::shared_ptr<Connection> &conn, uint64_t seq, std::string &&data);
+
+    // Thread-safe: called when the request queue has room again.
+    void request_resume();
+};
+
+bool set_nonblocking(int fd);
+
+#endif
@@ -13,17 +13,27 @@ private:
     DirNode* root;
     FreeBlockManager* block_manager;
     std::unordered_map<uint32_t, FileEntry>* inode_table;
+    TreeCounts* counts;
 
 public:
-    FileOperations(DirNode* root_, FreeBlockManager* fbm, std::unordered_map<uint32_t, FileEntry>* table)
-        : root(root_), block_manager(fbm), inode_table(table) {}
+    FileOperations(DirNode* root_, FreeBlockManager* fbm, std::unordered_map<uint32_t, FileEntry>* table,
+                   TreeCounts* counts_)
+        : root(root_), block_manager(fbm), inode_table(table), counts(counts_) {}
 
-    OFSErrorCodes file_create(const std::string &path, uint64_t size);
-    OFSErrorCodes file_delete(const std::string &path);
+    // The file's block is allocated and freed by the caller, outside the
+    // tree lock: create records block as the new file's inode, delete
+    // reports the inode it dropped.
+    OFSErrorCodes file_create(const std::string &path, uint64_t size, uint32_t block);
+    OFSErrorCodes file_delete(const std::string &path, uint32_t &block);
+    // The checks file_create would fail on, without changing anything; lets
+    // a caller skip allocating a block for a create that cannot succeed.
+    OFSErrorCodes check_create(const std::string &path);
     bool file_exists(const std::string &path);
 
     FileMetadata get_metadata(const std::string &path);
     OFSErrorCodes set_permissions(const std::string &path, uint32_t perms);
+    // Space and entry totals; constant time. Users and sessions are not
+    // known here and are left at zero.
     FSStats get_stats();
 
     void free_dir_tree(DirNode* node);
@@ -31,6 +41,17 @@ public:
     // New methods
     void file_edit(const std::string &path, const std::vector<char> &data, size_t offset);
     void file_read(const std::string &path, std::vector<char> &out);
+    // Refcounted view of the current contents (null if missing); stays
+    // valid and unchanged after the tree lock is released.
+    std::shared_ptr<const std::vector<char>> file_read_shared(const std::string &path);
+    // Bounded pieces of a file for the streaming operations. read copies at
+    // most max_len bytes from offset; write stores len bytes at offset
+    // (which may not lie past the end) and, if last, cuts the file there.
+    // Both report the file size afterwards.
+    OFSErrorCodes file_read_range(const std::string &path, uint64_t offset, size_t max_len,
+                                  std::vector<char> &out, uint64_t &file_size);
+    OFSErrorCodes file_write_range(const std::string &path, uint64_t offset, const char *data, size_t len,
+                                   bool last, uint64_t &file_size);
     void file_truncate(const std::string &path, size_t new_size);
     void file_rename(const std::string &old_path, const std::string &new_path);
 };
@@ -0,0 +1,82 @@
+#ifndef FRAME_PROTOCOL_HPP
+#define FRAME_PROTOCOL_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// Optional binary framing, chosen per connection by its first bytes.
+// Every frame is a fixed 20-byte header (big-endian fields), then meta_len
+// bytes of JSON metadata (the same object the line protocol carries), then
+// payload_len raw bytes. The payload replaces file_edit's "data" on the way
+// in and file_read's "content" on the way out, so file bytes are never
+// escaped into JSON.
+//
+//   offset  size  field
+//        0     4  magic "OFSF"
+//        4     1  version (1)
+//        5     1  opcode (FrameOpcode)
+//        6     2  flags (reserved, 0)
+//        8     4  meta_len
+//       12     8  payload_len
+namespace frame {
+
+constexpr size_t HEADER_SIZE = 20;
+constexpr uint8_t VERSION = 1;
+constexpr char MAGIC[4] = {'O', 'F', 'S', 'F'};
+constexpr uint32_t MAX_META_BYTES = 1024 * 1024;
+constexpr uint64_t MAX_PAYLOAD_BYTES = 256ULL * 1024 * 1024;
+
+enum class Opcode : uint8_t {
+    REQUEST = 1,
+    RESPONSE = 2
+};
+
+struct Header {
+    uint8_t version = VERSION;
+    Opcode opcode = Opcode::REQUEST;
+    uint16_t flags = 0;
+    uint32_t meta_len = 0;
+    uint64_t payload_len = 0;
+};
+
+inline bool has_magic(const char *p) {
+    return p[0] == MAGIC[0] && p[1] == MAGIC[1] && p[2] == MAGIC[2] && p[3] == MAGIC[3];
+}
+
+inline uint64_t read_be(const char *p, int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; ++i) v = (v << 8) | static_cast<uint8_t>(p[i]);
+    return v;
+}
+
+inline void write_be(char *p, uint64_t v, int bytes) {
+    for (int i = bytes - 1; i >= 0; --i) { p[i] = static_cast<char>(v & 0xff); v >>= 8; }
+}
+
+// p must point at HEADER_SIZE bytes. Returns false on bad magic/version.
+inline bool decode_header(const char *p, Header &h) {
+    if (!has_magic(p)) return false;
+    h.version = static_cast<uint8_t>(p[4]);
+    h.opcode = static_cast<Opcode>(p[5]);
+    h.flags = static_cast<uint16_t>(read_be(p + 6, 2));
+    h.meta_len = static_cast<uint32_t>(read_be(p + 8, 4));
+    h.payload_len = read_be(p + 12, 8);
+    return h.version == VERSION;
+}
+
+// Builds header + metadata as one buffer; the payload is sent separately.
+inline std::string encode(Opcode op, const std::string &meta, uint64_t payload_len) {
+    std::string out(HEADER_SIZE, '\0');
+    out[0] = MAGIC[0]; out[1] = MAGIC[1]; out[2] = MAGIC[2]; out[3] = MAGIC[3];
+    out[4] = static_cast<char>(VERSION);
+    out[5] = static_cast<char>(op);
+    write_be(&out[8], meta.size(), 4);
+    write_be(&out[12], payload_len, 8);
+    out += meta;
+    return out;
+}
+
+} // namespace frame
+
+#endif
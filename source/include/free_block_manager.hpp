@@ -4,15 +4,121 @@
 #include <vector>
 #include <cstdint>
 #include <cstddef>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <map>
+#include <set>
+#include <utility>
 
+// A run of consecutive blocks.
+struct Extent {
+    uint64_t start = 0;
+    uint64_t length = 0;
+};
+
+// How allocate_extent picks among the free runs. BEST_FIT takes the
+// smallest run that holds the whole request, which keeps long runs
+// intact; NEXT_FIT takes the first run that is long enough after the
+// previous extent, which keeps successive extents close together.
+enum class ExtentPolicy : uint8_t {
+    BEST_FIT,
+    NEXT_FIT
+};
+
+// Space figures taken in one go; every field is kept current as blocks
+// change, so reading them takes no lock however large the container is.
+// Groups are read one after another, so the figures may mix moments when
+// blocks change meanwhile. A run that crosses a group boundary counts as
+// one run per group.
+struct SpaceUsage {
+    uint64_t total_blocks = 0;
+    uint64_t free_blocks = 0;
+    uint64_t block_size = 0;
+    uint64_t free_runs = 0;          // maximal runs of free blocks
+    uint64_t largest_free_run = 0;   // in blocks
+    // Share of free space outside the longest run of its group: 0 while
+    // every group's free space is one run, towards 1 as it splinters.
+    double fragmentation = 0.0;
+};
+
+// Free space as a hierarchical bitmap. levels[0] has one bit per block
+// (1 = free); every level above has one bit per 64-bit word of the level
+// below, set while that word has any bit set. The top level is a single
+// word, so finding the lowest free block is one ctz per level however
+// full the container is (five levels cover 2^30 blocks).
+//
+// Next to the bitmap, every maximal run of free blocks is indexed by its
+// start and by its length, for the extent calls.
+//
+// The block space is cut into allocation groups of equal size, each with
+// its own bitmap, run index and lock. A thread allocates from its home
+// group and only moves on to the others when that one cannot serve the
+// request, so workers creating files at the same time rarely meet on a
+// lock. Frees go to whichever group owns the block.
 class FreeBlockManager {
 private:
-    std::vector<bool> blocks; // true = free, false = used
+    // One slice of the block space; positions inside it are local.
+    struct Group {
+        mutable std::mutex mtx;   // guards the members below; the atomics may be read without it
+        uint64_t base = 0;        // first block of the group
+        uint64_t count = 0;
+        std::vector<std::vector<uint64_t>> levels;
+        std::atomic<uint64_t> free_count{0};
+        std::atomic<uint64_t> run_count{0};      // published copies of the run index's
+        std::atomic<uint64_t> longest_run{0};    // size and longest entry
+
+        std::map<uint64_t, uint64_t> runs_by_start;             // start -> length
+        std::set<std::pair<uint64_t, uint64_t>> runs_by_length;  // (length, start)
+        uint64_t next_fit_cursor = 0;
+
+        // levels[0] from bits[base, base + count), or all free without bits.
+        void reset(const std::vector<bool> *bits);
+        void build_summaries();
+        void build_run_index();
+        int64_t find_free() const;               // lowest free block, or -1
+        bool is_free(uint64_t local) const;
+        // Flip blocks between free and used; every bit in mask must
+        // currently be in the other state, which keeps free_count exact.
+        void clear_bits(uint64_t word, uint64_t mask);  // marks blocks used
+        void set_bits(uint64_t word, uint64_t mask);    // marks blocks free
+        void mark_used(uint64_t start, uint64_t length);
+        void mark_free(uint64_t start, uint64_t length);
+        bool range_in_use(uint64_t start, uint64_t length) const;
+
+        void add_run(uint64_t start, uint64_t length);
+        void remove_run(std::map<uint64_t, uint64_t>::iterator it);
+        void take_from_runs(uint64_t start, uint64_t length);    // range must be free
+        void return_to_runs(uint64_t start, uint64_t length);    // range must have been used
+        void publish_runs();
+
+        // Appends up to n free blocks (as container indices) to out and
+        // returns how many it took.
+        size_t take(size_t n, std::vector<uint64_t> &out);
+        void release(uint64_t local);            // no-op if already free
+        bool take_extent(uint64_t min_len, uint64_t max_len, Extent &out, ExtentPolicy policy);
+    };
+
+    std::vector<std::unique_ptr<Group>> groups;
+    uint64_t group_span = 0;      // blocks per group but the last, a multiple of 64
+    unsigned wanted_groups = 1;
+    uint64_t block_count = 0;
     uint64_t block_size_bytes = 0;
 
+    void build_groups(uint64_t total_blocks, const std::vector<bool> *bits);
+    size_t home_group() const;
+    Group& group_of(uint64_t index) const { return *groups[index / group_span]; }
+
 public:
     FreeBlockManager() = default;
 
+    // Number of allocation groups used by the next init or
+    // load_from_vector_bool; groups smaller than MIN_GROUP_BLOCKS are
+    // merged. Neither of those may run alongside other calls.
+    static constexpr uint64_t MIN_GROUP_BLOCKS = 1024;
+    void set_group_count(unsigned n);
+    size_t group_count() const { return groups.size(); }
+
     // initialize blocks
     void init(uint64_t total_blocks, uint64_t block_size);
 
@@ -21,11 +127,31 @@ public:
     bool free_block(uint64_t index);
     bool is_free(uint64_t index) const;
 
+    // Bulk variants. allocate_n appends n free blocks to out, lowest first
+    // within each group and the home group first, or nothing if it cannot
+    // find n.
+    // free_n returns false if any index is out of range; the rest are
+    // freed regardless.
+    bool allocate_n(size_t n, std::vector<uint64_t> &out);
+    bool free_n(const std::vector<uint64_t> &indices);
+
+    // Contiguous allocation: a single run of at least min_len and at most
+    // max_len blocks, as long as the free space allows, from the first
+    // group (home first) that has one; extents never cross groups. False
+    // if no free run reaches min_len or 0 < min_len <= max_len does not
+    // hold.
+    bool allocate_extent(uint64_t min_len, uint64_t max_len, Extent &out,
+                         ExtentPolicy policy = ExtentPolicy::BEST_FIT);
+    // False (and nothing changes) if the range is out of bounds or any of
+    // its blocks is already free.
+    bool free_extent(uint64_t start, uint64_t length);
+
     // Helpers used by FS stats & persistence
     uint64_t total_blocks() const;
     uint64_t used_blocks() const;
     uint64_t free_blocks() const;
     uint64_t block_size() const;
+    SpaceUsage usage() const;
 
     // Serialize helpers
     std::vector<bool> to_vector_bool() const;
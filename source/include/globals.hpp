@@ -9,6 +9,7 @@
 #include "free_block_manager.hpp"
 #include "dir_tree.hpp"
 #include "user_manager.hpp"
+#include "server_metrics.hpp"
 
 // Global pointers (declared only)
 extern UserManager* g_user_mgr;
@@ -0,0 +1,126 @@
+#ifndef HTTP_PROTOCOL_HPP
+#define HTTP_PROTOCOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <strings.h>
+
+// Minimal HTTP/1.1 server side for the gateway listener: enough to carry
+// the JSON requests of the Flutter frontend (POST / or POST /api with a
+// Content-Length body) over persistent, pipelined connections. Chunked
+// request bodies are not supported.
+namespace http {
+
+constexpr size_t MAX_HEAD_BYTES = 64 * 1024;
+
+struct RequestHead {
+    std::string method;
+    std::string target;
+    size_t head_len = 0;        // bytes up to and including the blank line
+    uint64_t content_length = 0;
+    bool keep_alive = true;
+    bool chunked = false;
+};
+
+enum class ParseResult { INCOMPLETE, OK, BAD };
+
+inline std::string trim(const std::string &s) {
+    size_t a = s.find_first_not_of(" \t");
+    if (a == std::string::npos) return "";
+    size_t b = s.find_last_not_of(" \t");
+    return s.substr(a, b - a + 1);
+}
+
+inline bool has_token(const std::string &value, const char *token) {
+    size_t start = 0;
+    while (start <= value.size()) {
+        size_t comma = value.find(',', start);
+        if (comma == std::string::npos) comma = value.size();
+        if (strcasecmp(trim(value.substr(start, comma - start)).c_str(), token) == 0) return true;
+        start = comma + 1;
+    }
+    return false;
+}
+
+// Parses the request line and headers starting at buf[start].
+inline ParseResult parse_head(const std::string &buf, size_t start, RequestHead &h) {
+    size_t end = buf.find("\r\n\r\n", start);
+    if (end == std::string::npos) return buf.size() - start > MAX_HEAD_BYTES ? ParseResult::BAD : ParseResult::INCOMPLETE;
+    if (end - start > MAX_HEAD_BYTES) return ParseResult::BAD;
+    h = RequestHead();
+    h.head_len = end + 4 - start;
+
+    size_t line_end = buf.find("\r\n", start);
+    std::string line = buf.substr(start, line_end - start);
+    size_t sp1 = line.find(' ');
+    size_t sp2 = line.rfind(' ');
+    if (sp1 == std::string::npos || sp2 == sp1) return ParseResult::BAD;
+    h.method = line.substr(0, sp1);
+    h.target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+    std::string version = line.substr(sp2 + 1);
+    if (version == "HTTP/1.0") h.keep_alive = false;
+    else if (version != "HTTP/1.1") return ParseResult::BAD;
+
+    size_t pos = line_end + 2;
+    while (pos < end) {
+        size_t eol = buf.find("\r\n", pos);
+        std::string header = buf.substr(pos, eol - pos);
+        pos = eol + 2;
+        size_t colon = header.find(':');
+        if (colon == std::string::npos) return ParseResult::BAD;
+        std::string name = header.substr(0, colon);
+        std::string value = trim(header.substr(colon + 1));
+
+        if (strcasecmp(name.c_str(), "Content-Length") == 0) {
+            if (value.empty() || value.size() > 18 || value.find_first_not_of("0123456789") != std::string::npos) return ParseResult::BAD;
+            h.content_length = std::stoull(value);
+        } else if (strcasecmp(name.c_str(), "Transfer-Encoding") == 0) {
+            h.chunked = has_token(value, "chunked");
+        } else if (strcasecmp(name.c_str(), "Connection") == 0) {
+            if (has_token(value, "close")) h.keep_alive = false;
+            else if (has_token(value, "keep-alive")) h.keep_alive = true;
+        }
+    }
+    return ParseResult::OK;
+}
+
+inline const char* reason_phrase(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 204: return "No Content";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 413: return "Payload Too Large";
+        case 429: return "Too Many Requests";
+        case 501: return "Not Implemented";
+        case 503: return "Service Unavailable";
+        default:  return "Error";
+    }
+}
+
+// Full response with a JSON body. CORS is open because the frontend may be
+// served from a different origin (flutter web).
+inline std::string build_response(int status, const std::string &body, bool keep_alive) {
+    std::string out;
+    out.reserve(body.size() + 256);
+    out += "HTTP/1.1 ";
+    out += std::to_string(status);
+    out += ' ';
+    out += reason_phrase(status);
+    out += "\r\nContent-Type: application/json"
+           "\r\nAccess-Control-Allow-Origin: *"
+           "\r\nAccess-Control-Allow-Methods: POST, OPTIONS"
+           "\r\nAccess-Control-Allow-Headers: Content-Type";
+    if (status == 405) out += "\r\nAllow: POST, OPTIONS";
+    out += "\r\nContent-Length: ";
+    out += std::to_string(body.size());
+    out += keep_alive ? "\r\nConnection: keep-alive\r\n\r\n" : "\r\nConnection: close\r\n\r\n";
+    out += body;
+    return out;
+}
+
+} // namespace http
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef IO_BACKEND_HPP
+#define IO_BACKEND_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <sys/uio.h>
+
+// How the server talks to the kernel for bulk I/O. With IO_URING, socket
+// writes from an event loop and container reads/writes are queued into
+// an io_uring submission queue and issued with one syscall per batch;
+// with POSIX every operation is its own writev()/pread()/pwrite().
+// Readiness (accept, recv) always comes from epoll.
+enum class IoBackend : uint8_t {
+    POSIX,
+    IO_URING
+};
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+// Minimal io_uring ring driven through the raw syscalls (no liburing).
+// Not thread-safe: every ring belongs to a single thread.
+class IoUring {
+private:
+    int ring_fd = -1;
+
+    void *sq_ptr = nullptr;
+    size_t sq_map_size = 0;
+    void *cq_ptr = nullptr;
+    size_t cq_map_size = 0;
+    void *sqes_ptr = nullptr;
+    size_t sqes_map_size = 0;
+
+    unsigned *sq_head = nullptr;
+    unsigned *sq_tail = nullptr;
+    unsigned *sq_mask = nullptr;
+    unsigned *sq_array = nullptr;
+    unsigned *cq_head = nullptr;
+    unsigned *cq_tail = nullptr;
+    unsigned *cq_mask = nullptr;
+    struct io_uring_sqe *sqes = nullptr;
+    struct io_uring_cqe *cqes = nullptr;
+
+    unsigned entries = 0;
+    unsigned queued = 0;   // prepared but not yet submitted
+
+    struct io_uring_sqe* next_sqe();
+
+public:
+    IoUring() = default;
+    ~IoUring();
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    bool init(unsigned queue_depth, std::string &error_msg);
+    bool ready() const { return ring_fd >= 0; }
+    unsigned capacity() const { return entries; }
+
+    // Each returns false when the submission queue is full.
+    bool prep_writev(int fd, const iovec *iov, unsigned count, uint64_t offset, uint64_t user_data);
+    bool prep_read(int fd, void *buf, unsigned len, uint64_t offset, uint64_t user_data);
+    bool prep_write(int fd, const void *buf, unsigned len, uint64_t offset, uint64_t user_data);
+
+    // Submits everything prepared and waits until wait_nr completions are
+    // available. Returns false on a ring error.
+    bool submit_and_wait(unsigned wait_nr);
+
+    // Takes one completion; res is the syscall result (-errno on failure).
+    bool pop_completion(uint64_t &user_data, int32_t &res);
+};
+
+// One positioned piece of a container read or write.
+struct IoSegment {
+    uint64_t offset;
+    char *data;
+    size_t len;
+};
+
+namespace io {
+
+// Picks the backend from the config value ("auto", "io_uring" or "posix").
+// io_uring falls back to POSIX when the kernel refuses it.
+IoBackend select_backend(const std::string &name);
+IoBackend backend();
+const char* backend_name(IoBackend b);
+
+// Reads/writes every segment completely, batched through io_uring when
+// that backend is active.
+bool pread_all(int fd, std::vector<IoSegment> &segments, std::string &error_msg);
+bool pwrite_all(int fd, std::vector<IoSegment> &segments, std::string &error_msg);
+
+} // namespace io
+
+#endif
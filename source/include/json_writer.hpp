@@ -0,0 +1,66 @@
+#ifndef JSON_WRITER_HPP
+#define JSON_WRITER_HPP
+
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include "nlohmann/json.hpp"
+using json = nlohmann::json;
+
+// Appends JSON text straight to a buffer, without building a DOM. The
+// buffer keeps its capacity across clear(), so a writer that is reused for
+// every response stops allocating once it has grown to the largest one.
+// Commas are inserted automatically; the caller only has to pair
+// begin/end calls (at most 64 levels deep) and put a key() before every
+// value inside an object.
+// Strings are escaped the way json::dump() does it; bytes >= 0x80 are
+// copied as they are.
+class JsonWriter {
+private:
+    static const int MAX_DEPTH = 64;
+
+    std::string buf;
+    uint64_t has_items = 0;   // bit per open container: an element was written
+    int depth = 0;
+    bool after_key = false;
+
+    void separate();
+    void open(char c);
+    void close(char c);
+    void escape(const char *s, size_t n);
+
+public:
+    void clear();
+    const std::string& str() const { return buf; }
+    size_t size() const { return buf.size(); }
+    bool empty() const { return buf.empty(); }
+
+    JsonWriter& begin_object() { open('{'); return *this; }
+    JsonWriter& end_object() { close('}'); return *this; }
+    JsonWriter& begin_array() { open('['); return *this; }
+    JsonWriter& end_array() { close(']'); return *this; }
+    JsonWriter& key(const char *k);
+
+    JsonWriter& string_value(const char *s, size_t n);
+    JsonWriter& string_value(const std::string &s) { return string_value(s.data(), s.size()); }
+    JsonWriter& string_value(const char *s) { return string_value(s, std::strlen(s)); }
+    JsonWriter& uint_value(uint64_t v);
+    JsonWriter& int_value(int64_t v);
+    JsonWriter& bool_value(bool v);
+    JsonWriter& double_value(double v);
+    JsonWriter& null_value();
+    JsonWriter& json_value(const json &v);                // cold paths only: goes through dump()
+    JsonWriter& raw_value(const char *text, size_t n);    // text must be one complete JSON value
+
+    // A string value written in pieces: begin_string(), any number of
+    // string_chars(), end_string().
+    JsonWriter& begin_string();
+    JsonWriter& string_chars(const char *s, size_t n) { escape(s, n); return *this; }
+    JsonWriter& string_chars(const std::string &s) { escape(s.data(), s.size()); return *this; }
+    JsonWriter& end_string() { buf.push_back('"'); return *this; }
+
+    // Appends bytes after the document (e.g. the line protocol's '\n').
+    void append(const char *s, size_t n) { buf.append(s, n); }
+};
+
+#endif
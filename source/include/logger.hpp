@@ -0,0 +1,68 @@
+#ifndef LOGGER_HPP
+#define LOGGER_HPP
+
+#include <cstdint>
+
+// Leveled, asynchronous logging. A LOG_* call formats its line into a ring
+// owned by the calling thread and returns; a background thread drains the
+// rings to stdout (DEBUG, INFO) or stderr (WARN, ERROR). Apart from the
+// first call on each thread, logging takes no lock. A line that finds its
+// ring full is dropped and counted instead of waiting for the drain.
+//
+// Levels below OFS_LOG_LEVEL are compiled out: the call and its arguments
+// are never evaluated. By default DEBUG is kept unless NDEBUG is defined;
+// build with -DOFS_LOG_LEVEL=<0..3> to choose.
+
+enum class LogLevel : uint8_t {
+    DEBUG = 0,
+    INFO = 1,
+    WARN = 2,
+    ERROR = 3
+};
+
+#ifndef OFS_LOG_LEVEL
+#ifdef NDEBUG
+#define OFS_LOG_LEVEL 1
+#else
+#define OFS_LOG_LEVEL 0
+#endif
+#endif
+
+namespace logger {
+
+// printf-style; lines longer than MAX_LINE bytes are cut.
+constexpr unsigned MAX_LINE = 240;
+void write(LogLevel level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// Writes out everything logged so far; called on shutdown.
+void flush();
+
+// Lines lost to full rings since startup.
+uint64_t dropped();
+
+} // namespace logger
+
+// A disabled call still type-checks its arguments but never runs.
+#define OFS_LOG_DISCARD(level, ...) do { if (false) logger::write(level, __VA_ARGS__); } while (0)
+
+#if OFS_LOG_LEVEL <= 0
+#define LOG_DEBUG(...) logger::write(LogLevel::DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) OFS_LOG_DISCARD(LogLevel::DEBUG, __VA_ARGS__)
+#endif
+
+#if OFS_LOG_LEVEL <= 1
+#define LOG_INFO(...) logger::write(LogLevel::INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) OFS_LOG_DISCARD(LogLevel::INFO, __VA_ARGS__)
+#endif
+
+#if OFS_LOG_LEVEL <= 2
+#define LOG_WARN(...) logger::write(LogLevel::WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) OFS_LOG_DISCARD(LogLevel::WARN, __VA_ARGS__)
+#endif
+
+#define LOG_ERROR(...) logger::write(LogLevel::ERROR, __VA_ARGS__)
+
+#endif
@@ -6,6 +6,7 @@
 #include <cstring> // for std::strncpy, std::memset
 #include <cstdint>
 #include <algorithm>
+#include <memory>
 
 // ============================================================================
 // ENUMERATIONS - DO NOT MODIFY THESE VALUES
@@ -28,7 +29,10 @@ enum class OFSErrorCodes : int32_t {
     ERROR_NOT_IMPLEMENTED = -8,
     ERROR_INVALID_SESSION = -9,
     ERROR_DIRECTORY_NOT_EMPTY = -10,
-    ERROR_INVALID_OPERATION = -11
+    ERROR_INVALID_OPERATION = -11,
+    ERROR_SERVER_BUSY = -12,
+    ERROR_QUEUE_TIMEOUT = -13,
+    ERROR_THROTTLED = -14
 };
 
 enum class EntryType : uint8_t {
@@ -116,7 +120,9 @@ struct FileEntry {
     char owner[32];
     uint32_t inode;
     uint8_t reserved[47];
-    std::vector<char> content;
+    // Shared so readers can hold a snapshot without copying; writers
+    // copy-on-write when a snapshot is still out.
+    std::shared_ptr<std::vector<char>> content;
 
     FileEntry() = default;
 
@@ -199,15 +205,18 @@ struct FSStats {
     uint32_t total_directories;
     uint32_t total_users;
     uint32_t active_sessions;
-    double fragmentation;
-    uint8_t reserved[64];
+    double fragmentation;            // see SpaceUsage::fragmentation
+    uint64_t free_extents;           // maximal runs of free blocks
+    uint64_t largest_free_extent;    // in blocks
+    uint8_t reserved[48];
 
     FSStats() = default;
 
     FSStats(uint64_t total, uint64_t used, uint64_t free)
         : total_size(total), used_space(used), free_space(free),
           total_files(0), total_directories(0), total_users(0),
-          active_sessions(0), fragmentation(0.0) {
+          active_sessions(0), fragmentation(0.0),
+          free_extents(0), largest_free_extent(0) {
         std::memset(reserved, 0, sizeof(reserved));
     }
 };
@@ -0,0 +1,95 @@
+#ifndef OP_REGISTRY_HPP
+#define OP_REGISTRY_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstdint>
+#include "nlohmann/json.hpp"
+#include "odf_types.hpp"
+#include "request_queue.hpp"
+#include "request_args.hpp"
+#include "json_writer.hpp"
+using json = nlohmann::json;
+
+// How an operation uses the directory tree; dispatch takes the matching
+// lock around the handler (shared for READ, exclusive for WRITE).
+// WRITE_SELF needs the tree exclusively too, but the handler takes the
+// lock itself (unless ctx.tree_held) so it can do its other work, such as
+// allocating blocks, outside it.
+enum class TreeAccess : uint8_t {
+    NONE,
+    READ,
+    WRITE,
+    WRITE_SELF
+};
+
+// One request field an operation reads. Present fields must have their
+// type (see field_type()); required ones must be present.
+struct ParamSpec {
+    Field field;
+    bool required;
+};
+
+// What a handler sees of the request it runs.
+struct OpContext {
+    const RequestArgs &args;
+    const json *dom;                 // only for requests parsed into a DOM (batches)
+    const SessionInfo *session;      // null when the operation needs none
+    const Request *origin;           // the queued request; null inside a batch
+    std::vector<char> *payload_in;   // framed connections only
+    std::shared_ptr<const std::vector<char>> *payload_out;
+    JsonWriter *data_out;            // a handler may write "data" here instead of filling data
+    std::string error_message;       // set to override the default for a failing code
+    bool tree_held = false;          // the caller already holds the tree lock exclusively
+};
+
+// Returns the result code and fills data (left null for "no data"), or
+// writes the data value itself into ctx.data_out; that skips building a
+// DOM for operations answered often. The dispatcher builds the rest of
+// the response around it.
+using OpHandler = std::function<OFSErrorCodes(OpContext &ctx, json &data)>;
+
+struct OpSpec {
+    std::string name;
+    OpHandler handler;
+    std::vector<ParamSpec> params;
+    bool needs_session = true;
+    bool admin_only = false;
+    TreeAccess tree = TreeAccess::NONE;
+    Lane lane = Lane::METADATA;
+    bool batchable = true;
+};
+
+// Operation name -> spec. Names are looked up through a perfect hash
+// that is rebuilt whenever an operation is added, so a lookup is one hash,
+// one table probe and one string compare however many operations exist.
+// Operations are added during static initialization or before the server
+// starts; lookups are read-only and safe from any thread after that.
+class OpRegistry {
+private:
+    std::vector<OpSpec> specs;
+    std::vector<uint16_t> slots;   // spec index + 1; 0 = empty
+    uint64_t seed = 0;
+    uint64_t mask = 0;
+
+    static uint64_t hash(const char *s, size_t len, uint64_t seed);
+    void rebuild();
+
+public:
+    static OpRegistry& instance();
+
+    // False (and nothing changes) if the name is already taken.
+    bool add(OpSpec spec);
+    const OpSpec* find(const std::string &name) const;
+    size_t size() const { return specs.size(); }
+};
+
+// Registers an operation from any translation unit:
+//   static OpRegistrar reg({"my_op", handler, {{Field::PATH, true}}});
+struct OpRegistrar {
+    explicit OpRegistrar(OpSpec spec);
+};
+
+#endif
@@ -5,6 +5,39 @@ using json = nlohmann::json;
 #include "fs_core.hpp"
 #include "user_manager.hpp"
 #include "session_manager.hpp"
+#include "request_queue.hpp"
+#include "json_writer.hpp"
 
 
 json dispatch_operation(const json &req);
+
+// Reusable output buffers, one set per worker. Both keep their capacity
+// between requests, so serializing a response allocates nothing once
+// they have grown.
+struct ResponseBuffers {
+    JsonWriter response;   // the complete response object
+    JsonWriter data;       // the running operation's "data" value
+};
+
+// Runs a decoded request (see request_args.hpp) and writes the whole
+// response object into out.response; dom is only needed for a batch.
+// Framed-protocol variant: file_edit takes its bytes from payload_in
+// when the request has no "data" field, and file_read returns the file in
+// payload_out instead of data.content. payload_out shares the file's own
+// buffer, so the bytes reach the socket without being copied.
+// origin is the queued request, for operations that act on the client's
+// connection (see OpContext).
+void dispatch_operation(ResponseBuffers &out, const RequestArgs &args, const json *dom,
+                        std::vector<char> *payload_in,
+                        std::shared_ptr<const std::vector<char>> *payload_out,
+                        const Request *origin = nullptr);
+
+// Error response for a request that failed outside its handler.
+void write_error_response(JsonWriter &out, const RequestArgs &args, int32_t code, const std::string &message);
+std::string ofs_code_to_message(OFSErrorCodes c);
+
+// Answer for a request the rate limiter turned away before queueing it.
+json throttled_response(const RequestArgs &args, uint32_t retry_after_ms);
+
+// Which request queue lane an operation is scheduled on.
+Lane operation_lane(const std::string &op, bool has_payload);
@@ -16,8 +16,8 @@ public:
     // Validate path format
     bool validate_path(const std::string &path);
 
-    // Split path into components
-    std::vector<std::string> split_path(const std::string &path);
+    // Split path into components (see ::split_path)
+    std::pmr::vector<std::string_view> split_path(const std::string &path);
 
     // Locate directory node for a given path
     DirNode* locate_dir(const std::string &path);
@@ -3,12 +3,13 @@
 
 #include <string>
 #include <vector>
-#include <fstream>
 #include "dir_tree.hpp"
 #include "free_block_manager.hpp"
 #include "user_manager.hpp"
 #include "odf_types.hpp"
 
+struct ImageReader;
+
 class PersistenceManager {
 public:
     static bool fs_shutdown(const std::string &omni_path,
@@ -26,25 +27,23 @@ public:
                         std::string &error_msg);
 
 private:
-    // Save/load helpers
-    static bool save_header(std::ofstream &ofs, const OMNIHeader &header, std::string &error_msg);
-    static bool save_user_table(std::ofstream &ofs, const OMNIHeader &header,
+    // Save helpers serialize one section each into memory
+    static bool save_user_table(std::vector<char> &out, OMNIHeader &header,
                                 const UserManager &user_manager, std::string &error_msg);
-    static bool save_directory_tree(std::ofstream &ofs, const OMNIHeader &header,
+    static bool save_directory_tree(std::vector<char> &out,
                                     const DirectoryTree &dir_tree,
-                                    uint64_t &out_directory_bytes_written,
                                     std::string &error_msg);
-    static bool save_free_block_map(std::ofstream &ofs, const OMNIHeader &header,
+    static bool save_free_block_map(std::vector<char> &out,
                                     const FreeBlockManager &fbm,
-                                    uint64_t &out_offset,
                                     std::string &error_msg);
 
-    static bool load_user_table(std::ifstream &ifs, const OMNIHeader &header,
+    // Load helpers parse the container image read by fs_load
+    static bool load_user_table(ImageReader &in, const OMNIHeader &header,
                                 UserManager &user_manager, std::string &error_msg);
-    static bool load_directory_tree(std::ifstream &ifs, const OMNIHeader &header,
+    static bool load_directory_tree(ImageReader &in, const OMNIHeader &header,
                                     DirectoryTree &dir_tree,
                                     std::string &error_msg);
-    static bool load_free_block_map(std::ifstream &ifs, const OMNIHeader &header,
+    static bool load_free_block_map(ImageReader &in, const OMNIHeader &header,
                                     FreeBlockManager &fbm,
                                     std::string &error_msg);
 
@@ -0,0 +1,69 @@
+#ifndef RATE_LIMITER_HPP
+#define RATE_LIMITER_HPP
+
+#include <string>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+#include "request_queue.hpp"
+
+// Token bucket refilled continuously at `rate` tokens per second up to
+// `burst`; a request costs one token. Not synchronized on its own.
+struct TokenBucket {
+    double tokens = -1; // < 0 until first use; a new bucket starts full
+    std::chrono::steady_clock::time_point last;
+
+    void refill(double rate, double burst, std::chrono::steady_clock::time_point now);
+};
+
+// One bucket per operation class (request queue lane).
+struct LaneBuckets {
+    TokenBucket lane[LANE_COUNT];
+};
+
+// Requests per second allowed per operation class; 0 = unlimited.
+struct RateLimits {
+    uint32_t per_second[LANE_COUNT] = {0, 0, 0};
+};
+
+// Admission control in front of the request queue. Every connection owns
+// its buckets (touched only by the thread reading that connection); the
+// buckets of a session are shared by all its connections and live in a
+// sharded map here, so one tenant cannot get around its limit by opening
+// more sockets.
+class RateLimiter {
+private:
+    static constexpr size_t SHARDS = 16;
+    static constexpr size_t SWEEP_THRESHOLD = 4096; // sessions per shard before idle ones are dropped
+
+    struct Shard {
+        std::mutex mtx;
+        std::unordered_map<std::string, LaneBuckets> sessions;
+        std::chrono::steady_clock::time_point last_sweep;
+    };
+
+    RateLimits session_limits;
+    RateLimits connection_limits;
+    double burst_seconds = 1.0;
+    bool active = false;
+    Shard shards[SHARDS];
+
+    double burst(uint32_t rate) const;
+    void sweep(Shard &shard, std::chrono::steady_clock::time_point now);
+
+public:
+    // Called once at startup, before any loop runs.
+    void configure(const RateLimits &session, const RateLimits &connection, double burst_secs);
+    bool enabled() const { return active; }
+
+    // Takes one token of the lane's class from the connection's buckets and,
+    // if session_id is set, from the session's. If either is empty nothing
+    // is taken, retry_after_ms says when a token will be there, and the
+    // request must be refused.
+    bool admit(LaneBuckets &connection, const std::string &session_id, Lane lane, uint32_t &retry_after_ms);
+};
+
+extern RateLimiter g_rate_limiter;
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef REQUEST_ARENA_HPP
+#define REQUEST_ARENA_HPP
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+// Scratch memory for the request a worker is running. Allocations bump a
+// pointer through the worker's own block and are never freed one by one;
+// reset() gives everything back at once after the response has been sent.
+// A request that outgrows the block spills to the heap, and reset() frees
+// the spill too. Only one thread may use an arena.
+class RequestArena {
+private:
+    std::unique_ptr<char[]> block;
+    std::pmr::monotonic_buffer_resource pool;
+
+public:
+    static const size_t DEFAULT_SIZE = 64 * 1024;
+
+    explicit RequestArena(size_t size = DEFAULT_SIZE);
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+
+    std::pmr::memory_resource* resource() { return &pool; }
+    void reset() { pool.release(); }
+};
+
+// Where per-request temporaries should come from: the arena of the request
+// running on this thread, or the plain heap outside a request.
+std::pmr::memory_resource* request_memory();
+
+// Installs arena as the calling thread's request arena for one request and
+// resets it when the scope ends.
+class RequestArenaScope {
+private:
+    RequestArena &arena;
+
+public:
+    explicit RequestArenaScope(RequestArena &a);
+    ~RequestArenaScope();
+    RequestArenaScope(const RequestArenaScope&) = delete;
+    RequestArenaScope& operator=(const RequestArenaScope&) = delete;
+};
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef REQUEST_ARGS_HPP
+#define REQUEST_ARGS_HPP
+
+#include <string>
+#include <cstdint>
+#include "nlohmann/json.hpp"
+using json = nlohmann::json;
+
+// Every request field an operation can read. The JSON type of each is
+// fixed (see field_type()); "payload" is the login object holding
+// username and password, "operations" the array of a batch.
+enum class Field : uint8_t {
+    OPERATION,
+    REQUEST_ID,
+    SESSION_ID,
+    PATH,
+    OLD_PATH,
+    NEW_PATH,
+    DATA,
+    NAME,
+    USERNAME,
+    PASSWORD,
+    PASSWORD_HASH,
+    SIZE,
+    INDEX,
+    OFFSET,
+    CHUNK_SIZE,
+    PERMISSIONS,
+    ROLE,
+    LAST,
+    STOP_ON_ERROR,
+    PAYLOAD,
+    OPERATIONS,
+    COUNT
+};
+
+enum class ParamType : uint8_t {
+    STRING,
+    UINT,
+    BOOL,
+    OBJECT,
+    ARRAY
+};
+
+ParamType field_type(Field f);
+const char* field_name(Field f);
+
+// A request decoded into typed members. A field that was missing keeps its
+// default; one that had the wrong JSON type is flagged in `mistyped` and
+// left at its default too. Keys that are not fields are ignored.
+struct RequestArgs {
+    std::string operation;
+    std::string request_id;
+    std::string session_id;
+    std::string path;
+    std::string old_path;
+    std::string new_path;
+    std::string data;
+    std::string name;
+    std::string username;        // top level, or payload.username for login
+    std::string password;        // payload.password
+    std::string password_hash;
+    uint64_t size = 0;
+    uint64_t index = 0;
+    uint64_t offset = 0;
+    uint64_t chunk_size = 0;
+    uint64_t permissions = 0;
+    uint64_t role = 0;
+    bool last = false;
+    bool stop_on_error = false;
+
+    uint32_t present = 0;        // bit per Field seen
+    uint32_t mistyped = 0;       // bit per Field seen with the wrong type
+
+    bool has(Field f) const { return present & (1u << static_cast<unsigned>(f)); }
+    bool bad(Field f) const { return mistyped & (1u << static_cast<unsigned>(f)); }
+};
+
+// Decodes one request straight from its JSON text with a SAX parser; no
+// DOM is built. Only a batch, whose "operations" entries are requests of
+// their own, is also kept as a DOM in `dom`. Returns false if the text is
+// not a JSON object.
+bool parse_request(const char *begin, const char *end, RequestArgs &args, json &dom);
+
+// Same decoding for a request that is already a DOM (batch entries).
+void args_from_json(const json &req, RequestArgs &args);
+
+#endif
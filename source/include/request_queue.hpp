@@ -1,39 +1,262 @@
 // request_queue.hpp
 
 #pragma once
-#include <queue>
 #include <mutex>
 #include <condition_variable>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <atomic>
+#include <new>
+#include <thread>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
 #include "json.hpp"
+#include "request_args.hpp"
 using json = nlohmann::json;
 
+struct Connection;
+
+// Scheduling class of a request. Control and metadata requests are cheap
+// and must not wait behind multi-megabyte transfers in the bulk lane.
+enum class Lane : uint8_t {
+    CONTROL = 0,   // login/logout, server stats
+    METADATA = 1,  // namespace and attribute operations
+    BULK = 2       // file contents
+};
+constexpr int LANE_COUNT = 3;
+constexpr unsigned lane_bit(Lane l) { return 1u << static_cast<unsigned>(l); }
+constexpr unsigned ALL_LANES = (1u << LANE_COUNT) - 1;
+
 struct Request {
-    json request;
-    int client_socket;
+    RequestArgs args;
+    json request;                // DOM of the request; only batches keep one
+    std::shared_ptr<Connection> conn;
+    std::chrono::steady_clock::time_point enqueued_at;
+    std::vector<char> payload;   // raw bytes of a framed request
+    uint64_t http_seq = 0;       // position of the response on an HTTP connection
+    bool http_keep_alive = true;
+    Lane lane = Lane::METADATA;
+};
+
+// Bounded lock-free multi-producer/multi-consumer ring (Vyukov). Every cell
+// carries a sequence number that tells producers and consumers whose turn
+// it is, so a push or pop is one CAS on the shared cursor plus a move of
+// the element. Capacity is rounded up to a power of two.
+template <typename T>
+class MpmcRing {
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        alignas(T) unsigned char storage[sizeof(T)];
+        T* ptr() { return std::launder(reinterpret_cast<T*>(storage)); }
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> enqueue_pos{0};
+    alignas(64) std::atomic<size_t> dequeue_pos{0};
+
+public:
+    explicit MpmcRing(size_t capacity) { reset(capacity); }
+
+    ~MpmcRing() {
+        T tmp;
+        while (try_pop(tmp)) {}
+    }
+
+    MpmcRing(const MpmcRing&) = delete;
+    MpmcRing& operator=(const MpmcRing&) = delete;
+
+    // Not thread-safe; only call while no one else uses the ring.
+    void reset(size_t capacity) {
+        T tmp;
+        if (cells) while (try_pop(tmp)) {}
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; ++i) cells[i].seq.store(i, std::memory_order_relaxed);
+        mask = size - 1;
+        enqueue_pos.store(0, std::memory_order_relaxed);
+        dequeue_pos.store(0, std::memory_order_relaxed);
+    }
+
+    bool try_push(T &&value) {
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false; // full
+            } else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        new (cell->storage) T(std::move(value));
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T &out) {
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false; // empty
+            } else {
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        out = std::move(*cell->ptr());
+        cell->ptr()->~T();
+        cell->seq.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate under concurrency.
+    size_t size() const {
+        size_t head = dequeue_pos.load(std::memory_order_relaxed);
+        size_t tail = enqueue_pos.load(std::memory_order_relaxed);
+        return tail >= head ? tail - head : 0;
+    }
+
+    size_t capacity() const { return mask + 1; }
 };
 
 // request_queue.hpp (continued)
 
+// Bounded queue between the event loops (producers) and the workers, with
+// one ring per lane. A full lane refuses new requests; once it has drained
+// to half capacity the drain listener is called so producers can resume.
+// Each worker serves a set of lanes, always taking the highest-priority
+// non-empty one. Idle workers spin briefly, then yield, then park; workers
+// that serve the same lanes share a condition variable that producers only
+// touch when someone in it is actually parked.
 class RequestQueue {
 private:
-    std::queue<Request> q;
-    std::mutex mtx;
-    std::condition_variable cv;
+    static constexpr int SPIN_ROUNDS = 128;
+    static constexpr int YIELD_ROUNDS = 16;
+
+    struct Parker {
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::atomic<int> sleepers{0};
+    };
+
+    MpmcRing<Request> rings[LANE_COUNT];
+    std::atomic<bool> producer_blocked[LANE_COUNT] = {};
+    std::function<void()> on_drain;
+
+    Parker parkers[ALL_LANES + 1]; // indexed by the lane mask a worker serves
+
+    static void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+    bool try_pop_lanes(unsigned lanes, Request &r) {
+        for (int l = 0; l < LANE_COUNT; ++l)
+            if ((lanes & (1u << l)) && rings[l].try_pop(r)) { after_pop(static_cast<Lane>(l)); return true; }
+        return false;
+    }
+
+    void after_pop(Lane lane) {
+        const MpmcRing<Request> &ring = rings[static_cast<int>(lane)];
+        std::atomic<bool> &blocked = producer_blocked[static_cast<int>(lane)];
+        if (blocked.load(std::memory_order_relaxed) &&
+            ring.size() <= ring.capacity() / 2 &&
+            blocked.exchange(false)) {
+            if (on_drain) on_drain();
+        }
+    }
+
+    // Wakes one parked worker that serves lane, preferring workers that
+    // serve the fewest lanes (the ones dedicated to it).
+    void wake_for(Lane lane) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        unsigned bit = lane_bit(lane);
+        for (int pass = 1; pass <= LANE_COUNT; ++pass) {
+            for (unsigned mask = 1; mask <= ALL_LANES; ++mask) {
+                if (!(mask & bit) || __builtin_popcount(mask) != pass) continue;
+                Parker &p = parkers[mask];
+                if (p.sleepers.load(std::memory_order_relaxed) > 0) {
+                    std::lock_guard<std::mutex> lock(p.mtx);
+                    p.cv.notify_one(); // wake consumer
+                    return;
+                }
+            }
+        }
+    }
 
 public:
-    void push(const Request& r) {
-        std::unique_lock<std::mutex> lock(mtx);
-        q.push(r);
-        cv.notify_one(); // wake consumer
+    explicit RequestQueue(size_t capacity = 1024)
+        : rings{MpmcRing<Request>(capacity), MpmcRing<Request>(capacity), MpmcRing<Request>(capacity)} {}
+
+    // Capacity of each lane. Must be called before producers and workers start.
+    void set_capacity(size_t capacity) {
+        for (auto &ring : rings) ring.reset(capacity);
     }
 
-    Request pop() {
-        std::unique_lock<std::mutex> lock(mtx);
-        cv.wait(lock, [&]{ return !q.empty(); }); // wait for request
-        Request r = q.front();
-        q.pop();
-        return r;
+    // Must be set before producers start.
+    void set_drain_listener(std::function<void()> fn) { on_drain = std::move(fn); }
+
+    // Queues r on r.lane. On failure r is left untouched so the caller can
+    // retry it later.
+    bool try_push(Request &&r) {
+        Lane lane = r.lane;
+        MpmcRing<Request> &ring = rings[static_cast<int>(lane)];
+        r.enqueued_at = std::chrono::steady_clock::now();
+        if (!ring.try_push(std::move(r))) {
+            producer_blocked[static_cast<int>(lane)].store(true);
+            // A worker may have drained the ring before it could see the
+            // flag; retry so that a refusal always means there is work
+            // left that will eventually trigger the drain listener.
+            if (!ring.try_push(std::move(r))) return false;
+        }
+        wake_for(lane);
+        return true;
     }
-};
 
+    // Blocks until a request on one of lanes (a mask of lane_bit()s) is
+    // available; lower-numbered lanes are served first.
+    Request pop(unsigned lanes = ALL_LANES) {
+        Request r;
+        // Spinning only pays off if a producer can run on another core.
+        static const int spin_rounds = std::thread::hardware_concurrency() > 1 ? SPIN_ROUNDS : 0;
+        for (int i = 0; i < spin_rounds; ++i) {
+            if (try_pop_lanes(lanes, r)) return r;
+            cpu_relax();
+        }
+        for (int i = 0; i < YIELD_ROUNDS; ++i) {
+            if (try_pop_lanes(lanes, r)) return r;
+            std::this_thread::yield();
+        }
 
+        Parker &p = parkers[lanes & ALL_LANES];
+        std::unique_lock<std::mutex> lock(p.mtx);
+        p.sleepers.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!try_pop_lanes(lanes, r)) p.cv.wait(lock); // wait for request
+        p.sleepers.fetch_sub(1);
+        return r;
+    }
+
+    size_t size() const {
+        size_t total = 0;
+        for (auto &ring : rings) total += ring.size();
+        return total;
+    }
+    size_t size(Lane lane) const { return rings[static_cast<int>(lane)].size(); }
+    size_t capacity() const { return rings[0].capacity(); }
+};
@@ -13,9 +13,6 @@ using json = nlohmann::json;
 
 
 extern RequestQueue requestQueue;
-void server_init(const std::string &omni_file, int port);
-void start_server(int port);
-void* client_thread(void* arg);
+void server_init(const std::string &omni_file, const Config &cfg);
+void start_server(const Config &cfg);
 void* worker_thread(void* arg);
-
-void start_server(int port);
@@ -0,0 +1,21 @@
+#ifndef SERVER_METRICS_HPP
+#define SERVER_METRICS_HPP
+
+#include <atomic>
+#include <cstdint>
+
+// Process-wide transport counters, reported by the server_stats operation.
+struct ServerMetrics {
+    std::atomic<uint64_t> connections_accepted{0};
+    std::atomic<uint64_t> connections_rejected{0};   // over max_connections
+    std::atomic<uint64_t> connections_active{0};
+    std::atomic<uint64_t> requests_enqueued{0};
+    std::atomic<uint64_t> requests_completed{0};
+    std::atomic<uint64_t> requests_timed_out{0};     // waited longer than queue_timeout
+    std::atomic<uint64_t> backpressure_pauses{0};    // reads paused on a full queue
+    std::atomic<uint64_t> requests_throttled{0};     // refused by the rate limiter
+};
+
+extern ServerMetrics g_server_metrics;
+
+#endif
@@ -7,9 +7,12 @@
 #include <string>
 #include <random>
 #include <chrono>
+#include <shared_mutex>
+#include <mutex>
 
 class SessionManager {
 private:
+    mutable std::shared_mutex mtx; // guards sessions
     std::unordered_map<std::string, SessionInfo> sessions;
     UserManager* user_manager; // Reference to the user manager for user info
 
@@ -21,8 +24,9 @@ public:
     std::string create_session(const std::string &username);
     bool validate_session(const std::string &session_id);
     bool destroy_session(const std::string &session_id);
+    size_t session_count() const;
     bool update_activity(const std::string &session_id);
-    SessionInfo* get_session(const std::string &session_id);
+    bool get_session(const std::string &session_id, SessionInfo &out);
 };
 
 #endif
@@ -0,0 +1,159 @@
+#ifndef SHM_CHANNEL_HPP
+#define SHM_CHANNEL_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <algorithm>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Shared-memory transport for clients on the same host. The client creates
+// a POSIX shared memory object laid out as below, then asks the server to
+// map it with {"operation":"shm_attach","name":"/..."} over the unix socket.
+// From then on the two byte rings carry the usual newline-delimited JSON:
+// requests from client to server, responses back. Each ring has one
+// producer and one consumer; the sequence words double as futex doorbells,
+// and a side only issues FUTEX_WAKE when the other one has said it sleeps.
+// The channel ends when either side sets closed or the unix connection
+// that attached it goes away.
+namespace shm {
+
+constexpr uint32_t MAGIC = 0x5353464F; // "OFSS" little-endian
+constexpr uint32_t VERSION = 1;
+constexpr uint64_t MIN_RING_BYTES = 4096;
+constexpr uint64_t MAX_RING_BYTES = 64ULL * 1024 * 1024;
+
+struct RingHeader {
+    alignas(64) std::atomic<uint64_t> head;      // bytes consumed
+    alignas(64) std::atomic<uint64_t> tail;      // bytes produced
+    alignas(64) std::atomic<uint32_t> data_seq;  // bumped after tail moves
+    std::atomic<uint32_t> data_waiters;          // consumer is asleep
+    alignas(64) std::atomic<uint32_t> space_seq; // bumped after head moves
+    std::atomic<uint32_t> space_waiters;         // producer is asleep
+};
+
+struct Layout {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t ring_bytes;                 // per ring, power of two
+    std::atomic<uint32_t> closed;
+    RingHeader requests;                 // client -> server
+    RingHeader responses;                // server -> client
+    // followed by ring_bytes of request data, then ring_bytes of response data
+};
+
+inline size_t segment_size(uint64_t ring_bytes) {
+    return sizeof(Layout) + 2 * static_cast<size_t>(ring_bytes);
+}
+
+inline bool valid_ring_bytes(uint64_t n) {
+    return n >= MIN_RING_BYTES && n <= MAX_RING_BYTES && (n & (n - 1)) == 0;
+}
+
+// Shared (not process-private) futex operations on a 32-bit word.
+inline void futex_wait(std::atomic<uint32_t> *word, uint32_t expected, int timeout_ms) {
+    timespec ts{timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+}
+
+inline void futex_wake(std::atomic<uint32_t> *word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+}
+
+// One side's view of a ring inside a mapped Layout.
+class Ring {
+private:
+    RingHeader *h = nullptr;
+    char *data = nullptr;
+    uint64_t mask = 0;
+
+public:
+    Ring() = default;
+    Ring(RingHeader *header, char *bytes, uint64_t size) : h(header), data(bytes), mask(size - 1) {}
+
+    // Producer: copies as much of buf as fits and returns the byte count.
+    // head and tail live in memory the peer can scribble on, so a pair
+    // that claims more than a full ring yields 0 here (see inconsistent()).
+    size_t write_some(const char *buf, size_t len) {
+        uint64_t tail = h->tail.load(std::memory_order_relaxed);
+        uint64_t head = h->head.load(std::memory_order_acquire);
+        uint64_t used = tail - head;
+        if (used > mask + 1) return 0;
+        size_t n = static_cast<size_t>(std::min<uint64_t>(len, mask + 1 - used));
+        if (n == 0) return 0;
+        size_t at = static_cast<size_t>(tail & mask);
+        size_t first = std::min(n, static_cast<size_t>(mask + 1) - at);
+        std::memcpy(data + at, buf, first);
+        std::memcpy(data, buf + first, n - first);
+        h->tail.store(tail + n, std::memory_order_release);
+        h->data_seq.fetch_add(1, std::memory_order_seq_cst);
+        if (h->data_waiters.load(std::memory_order_seq_cst)) futex_wake(&h->data_seq);
+        return n;
+    }
+
+    // Consumer: copies up to len available bytes into buf.
+    size_t read_some(char *buf, size_t len) {
+        uint64_t head = h->head.load(std::memory_order_relaxed);
+        uint64_t tail = h->tail.load(std::memory_order_acquire);
+        uint64_t used = tail - head;
+        if (used > mask + 1) return 0;
+        size_t n = static_cast<size_t>(std::min<uint64_t>(len, used));
+        if (n == 0) return 0;
+        size_t at = static_cast<size_t>(head & mask);
+        size_t first = std::min(n, static_cast<size_t>(mask + 1) - at);
+        std::memcpy(buf, data + at, first);
+        std::memcpy(buf + first, data, n - first);
+        h->head.store(head + n, std::memory_order_release);
+        h->space_seq.fetch_add(1, std::memory_order_seq_cst);
+        if (h->space_waiters.load(std::memory_order_seq_cst)) futex_wake(&h->space_seq);
+        return n;
+    }
+
+    // head and tail further apart than the ring allows; only a misbehaving
+    // peer gets there, and the channel should be treated as closed.
+    bool inconsistent() const {
+        return h->tail.load(std::memory_order_acquire) - h->head.load(std::memory_order_acquire) > mask + 1;
+    }
+
+    bool empty() const {
+        return h->head.load(std::memory_order_acquire) == h->tail.load(std::memory_order_acquire);
+    }
+    bool full() const {
+        return h->tail.load(std::memory_order_acquire) - h->head.load(std::memory_order_acquire) > mask;
+    }
+
+    // Sleep until the ring has data (consumer) or room (producer), or the
+    // timeout passes. Spurious returns are fine; callers loop.
+    void wait_data(int timeout_ms) {
+        uint32_t seq = h->data_seq.load(std::memory_order_seq_cst);
+        h->data_waiters.store(1, std::memory_order_seq_cst);
+        if (empty()) futex_wait(&h->data_seq, seq, timeout_ms);
+        h->data_waiters.store(0, std::memory_order_relaxed);
+    }
+    void wait_space(int timeout_ms) {
+        uint32_t seq = h->space_seq.load(std::memory_order_seq_cst);
+        h->space_waiters.store(1, std::memory_order_seq_cst);
+        if (full()) futex_wait(&h->space_seq, seq, timeout_ms);
+        h->space_waiters.store(0, std::memory_order_relaxed);
+    }
+};
+
+// ring_bytes is passed in rather than read from l: the server must build
+// both rings from the one value it validated, not from whatever the
+// client has written to the header since.
+inline Ring request_ring(Layout *l, uint64_t ring_bytes) {
+    return Ring(&l->requests, reinterpret_cast<char*>(l + 1), ring_bytes);
+}
+
+inline Ring response_ring(Layout *l, uint64_t ring_bytes) {
+    return Ring(&l->responses, reinterpret_cast<char*>(l + 1) + ring_bytes, ring_bytes);
+}
+
+} // namespace shm
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef SHM_TRANSPORT_HPP
+#define SHM_TRANSPORT_HPP
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include "shm_channel.hpp"
+
+class RequestQueue;
+
+// Server end of one shared-memory channel (see shm_channel.hpp). A reader
+// thread sleeps on the request ring's doorbell, parses complete lines and
+// pushes them to the request queue like any socket connection would;
+// workers write responses back through send().
+class ShmChannel : public std::enable_shared_from_this<ShmChannel> {
+private:
+    std::string name;
+    shm::Layout *layout = nullptr;
+    size_t map_size = 0;
+    shm::Ring requests;
+    shm::Ring responses;
+    std::mutex send_mtx;         // one worker writes to the response ring at a time
+    std::atomic<bool> stopping{false};
+
+    void reader_loop(RequestQueue &queue);
+
+public:
+    ShmChannel() = default;
+    ~ShmChannel();
+    ShmChannel(const ShmChannel&) = delete;
+    ShmChannel& operator=(const ShmChannel&) = delete;
+
+    // Maps the client's shared memory object and checks its header.
+    bool attach(const std::string &shm_name, std::string &error_msg);
+
+    // Starts the reader thread; it keeps the channel alive until close().
+    void start(RequestQueue &queue);
+
+    // Thread-safe: appends one response line, waiting for the client to
+    // make room if the ring is full. Gives up once the channel is closed,
+    // and closes it if the client makes no room for SHM_SEND_TIMEOUT_MS.
+    void send(const std::string &data);
+
+    void close();
+    bool closed() const;
+};
+
+#endif
@@ -5,11 +5,16 @@
 #include <unordered_map>
 #include <string>
 #include <vector>
+#include <shared_mutex>
+#include <mutex>
 
 class UserManager {
 private:
+    mutable std::shared_mutex mtx; // guards users
     std::unordered_map<std::string, UserInfo> users; 
 
+    UserInfo* find_user_locked(const std::string &username);
+
 public:
     UserManager() = default;
 
@@ -18,8 +23,10 @@ public:
 
     bool create_user(const std::string &username, const std::string &password_hash, UserRole role, uint64_t created_time);
     bool delete_user(const std::string &username);
+    size_t user_count() const;
 
-    UserInfo* find_user(const std::string &username);
+    // Copies the user out so callers never hold a pointer into the map
+    bool find_user(const std::string &username, UserInfo &out);
     bool verify_password(const std::string &username, const std::string &password_hash);
     void dump_users() const;
 
@@ -0,0 +1,234 @@
+#include "../include/io_backend.hpp"
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+
+static IoBackend g_io_backend = IoBackend::POSIX;
+
+// Largest single read/write handed to the kernel; bigger segments are split.
+static const size_t IO_CHUNK = 1 << 20;
+
+static int sys_io_uring_setup(unsigned entries, io_uring_params *p) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+// ===================== RING SETUP =====================
+IoUring::~IoUring() {
+    if (sqes_ptr) munmap(sqes_ptr, sqes_map_size);
+    if (cq_ptr && cq_ptr != sq_ptr) munmap(cq_ptr, cq_map_size);
+    if (sq_ptr) munmap(sq_ptr, sq_map_size);
+    if (ring_fd >= 0) close(ring_fd);
+}
+
+bool IoUring::init(unsigned queue_depth, std::string &error_msg) {
+    io_uring_params p;
+    std::memset(&p, 0, sizeof(p));
+    int fd = sys_io_uring_setup(queue_depth, &p);
+    if (fd < 0) { error_msg = std::string("io_uring_setup failed: ") + std::strerror(errno); return false; }
+    ring_fd = fd;
+
+    sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) sq_map_size = cq_map_size = std::max(sq_map_size, cq_map_size);
+
+    sq_ptr = mmap(nullptr, sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq_ptr == MAP_FAILED) { sq_ptr = nullptr; error_msg = "Failed to map io_uring SQ ring"; return false; }
+    if (single_mmap) {
+        cq_ptr = sq_ptr;
+    } else {
+        cq_ptr = mmap(nullptr, cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cq_ptr == MAP_FAILED) { cq_ptr = nullptr; error_msg = "Failed to map io_uring CQ ring"; return false; }
+    }
+    sqes_map_size = p.sq_entries * sizeof(io_uring_sqe);
+    sqes_ptr = mmap(nullptr, sqes_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes_ptr == MAP_FAILED) { sqes_ptr = nullptr; error_msg = "Failed to map io_uring SQEs"; return false; }
+
+    char *sq = static_cast<char*>(sq_ptr);
+    char *cq = static_cast<char*>(cq_ptr);
+    sq_head  = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+    sq_tail  = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+    sq_mask  = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+    cq_head  = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+    cq_tail  = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+    cq_mask  = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+    sqes = static_cast<io_uring_sqe*>(sqes_ptr);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+    entries = p.sq_entries;
+    return true;
+}
+
+// ===================== SUBMISSION =====================
+io_uring_sqe* IoUring::next_sqe() {
+    unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *sq_tail;
+    if (tail - head >= entries) return nullptr;
+    unsigned index = tail & *sq_mask;
+    io_uring_sqe *sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array[index] = index;
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++queued;
+    return sqe;
+}
+
+bool IoUring::prep_writev(int fd, const iovec *iov, unsigned count, uint64_t offset, uint64_t user_data) {
+    io_uring_sqe *sqe = next_sqe();
+    if (!sqe) return false;
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(iov);
+    sqe->len = count;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+    return true;
+}
+
+bool IoUring::prep_read(int fd, void *buf, unsigned len, uint64_t offset, uint64_t user_data) {
+    io_uring_sqe *sqe = next_sqe();
+    if (!sqe) return false;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buf);
+    sqe->len = len;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+    return true;
+}
+
+bool IoUring::prep_write(int fd, const void *buf, unsigned len, uint64_t offset, uint64_t user_data) {
+    io_uring_sqe *sqe = next_sqe();
+    if (!sqe) return false;
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buf);
+    sqe->len = len;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+    return true;
+}
+
+bool IoUring::submit_and_wait(unsigned wait_nr) {
+    unsigned to_submit = queued;
+    while (true) {
+        int ret = sys_io_uring_enter(ring_fd, to_submit, wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0);
+        if (ret >= 0) {
+            queued -= std::min(queued, static_cast<unsigned>(ret));
+            return true;
+        }
+        if (errno == EINTR) { to_submit = 0; continue; }
+        return false;
+    }
+}
+
+bool IoUring::pop_completion(uint64_t &user_data, int32_t &res) {
+    unsigned head = *cq_head;
+    if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) return false;
+    const io_uring_cqe &cqe = cqes[head & *cq_mask];
+    user_data = cqe.user_data;
+    res = cqe.res;
+    __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// ===================== BACKEND SELECTION =====================
+namespace io {
+
+IoBackend select_backend(const std::string &name) {
+    g_io_backend = IoBackend::POSIX;
+    if (name == "posix" || name == "epoll") return g_io_backend;
+
+    IoUring probe;
+    std::string err;
+    if (probe.init(4, err)) {
+        g_io_backend = IoBackend::IO_URING;
+    } else if (name == "io_uring") {
+        std::cerr << "[ERROR] " << err << ", falling back to posix I/O\n";
+    }
+    return g_io_backend;
+}
+
+IoBackend backend() { return g_io_backend; }
+
+const char* backend_name(IoBackend b) {
+    return b == IoBackend::IO_URING ? "io_uring" : "posix";
+}
+
+// ===================== CONTAINER I/O =====================
+// Splits segments into IO_CHUNK pieces and keeps the ring full; short
+// transfers are resubmitted for the remainder.
+static bool run_batched(int fd, std::vector<IoSegment> &segments, bool write, std::string &error_msg) {
+    struct Piece { uint64_t offset; char *data; size_t len; };
+    std::vector<Piece> pieces;
+    for (auto &s : segments)
+        for (size_t done = 0; done < s.len; done += IO_CHUNK)
+            pieces.push_back({s.offset + done, s.data + done, std::min(IO_CHUNK, s.len - done)});
+
+    IoUring ring;
+    if (!ring.init(64, error_msg)) return false;
+
+    size_t next = 0, in_flight = 0;
+    while (next < pieces.size() || in_flight > 0) {
+        while (next < pieces.size()) {
+            Piece &p = pieces[next];
+            unsigned len = static_cast<unsigned>(p.len);
+            bool ok = write ? ring.prep_write(fd, p.data, len, p.offset, next)
+                            : ring.prep_read(fd, p.data, len, p.offset, next);
+            if (!ok) break;
+            ++next;
+            ++in_flight;
+        }
+        if (!ring.submit_and_wait(1)) { error_msg = std::string("io_uring_enter failed: ") + std::strerror(errno); return false; }
+
+        uint64_t idx;
+        int32_t res;
+        while (ring.pop_completion(idx, res)) {
+            --in_flight;
+            Piece &p = pieces[idx];
+            if (res < 0) { error_msg = std::string("Container I/O failed: ") + std::strerror(-res); return false; }
+            if (res == 0) { error_msg = "Unexpected end of container"; return false; }
+            if (static_cast<size_t>(res) < p.len) {
+                // Short transfer: queue the rest as a new piece.
+                pieces.push_back({p.offset + res, p.data + res, p.len - res});
+            }
+        }
+    }
+    return true;
+}
+
+static bool run_posix(int fd, std::vector<IoSegment> &segments, bool write, std::string &error_msg) {
+    for (auto &s : segments) {
+        size_t done = 0;
+        while (done < s.len) {
+            ssize_t n = write ? pwrite(fd, s.data + done, s.len - done, static_cast<off_t>(s.offset + done))
+                              : pread(fd, s.data + done, s.len - done, static_cast<off_t>(s.offset + done));
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) { error_msg = std::string("Container I/O failed: ") + std::strerror(errno); return false; }
+            if (n == 0) { error_msg = "Unexpected end of container"; return false; }
+            done += static_cast<size_t>(n);
+        }
+    }
+    return true;
+}
+
+bool pread_all(int fd, std::vector<IoSegment> &segments, std::string &error_msg) {
+    if (g_io_backend == IoBackend::IO_URING) return run_batched(fd, segments, false, error_msg);
+    return run_posix(fd, segments, false, error_msg);
+}
+
+bool pwrite_all(int fd, std::vector<IoSegment> &segments, std::string &error_msg) {
+    if (g_io_backend == IoBackend::IO_URING) return run_batched(fd, segments, true, error_msg);
+    return run_posix(fd, segments, true, error_msg);
+}
+
+} // namespace io
@@ -0,0 +1,135 @@
+#include "../include/json_writer.hpp"
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+void JsonWriter::clear() {
+    buf.clear();
+    has_items = 0;
+    depth = 0;
+    after_key = false;
+}
+
+// Called before every key, value and container start.
+void JsonWriter::separate() {
+    if (after_key) {
+        after_key = false;
+        return;
+    }
+    if (depth == 0) return;
+    uint64_t bit = 1ULL << (depth - 1);
+    if (has_items & bit) buf.push_back(',');
+    has_items |= bit;
+}
+
+void JsonWriter::open(char c) {
+    separate();
+    buf.push_back(c);
+    if (depth < MAX_DEPTH) has_items &= ~(1ULL << depth);
+    ++depth;
+}
+
+void JsonWriter::close(char c) {
+    buf.push_back(c);
+    --depth;
+}
+
+JsonWriter& JsonWriter::key(const char *k) {
+    separate();
+    buf.push_back('"');
+    escape(k, std::strlen(k));
+    buf.append("\":", 2);
+    after_key = true;
+    return *this;
+}
+
+void JsonWriter::escape(const char *s, size_t n) {
+    static const char HEX[] = "0123456789abcdef";
+    size_t run = 0;   // start of the current stretch that needs no escaping
+    for (size_t i = 0; i < n; ++i) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        buf.append(s + run, i - run);
+        run = i + 1;
+        switch (c) {
+            case '"':  buf.append("\\\"", 2); break;
+            case '\\': buf.append("\\\\", 2); break;
+            case '\b': buf.append("\\b", 2); break;
+            case '\f': buf.append("\\f", 2); break;
+            case '\n': buf.append("\\n", 2); break;
+            case '\r': buf.append("\\r", 2); break;
+            case '\t': buf.append("\\t", 2); break;
+            default: {
+                char u[6] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xF]};
+                buf.append(u, sizeof(u));
+            }
+        }
+    }
+    buf.append(s + run, n - run);
+}
+
+JsonWriter& JsonWriter::string_value(const char *s, size_t n) {
+    begin_string();
+    escape(s, n);
+    buf.push_back('"');
+    return *this;
+}
+
+JsonWriter& JsonWriter::begin_string() {
+    separate();
+    buf.push_back('"');
+    return *this;
+}
+
+JsonWriter& JsonWriter::uint_value(uint64_t v) {
+    separate();
+    char tmp[24];
+    auto r = std::to_chars(tmp, tmp + sizeof(tmp), v);
+    buf.append(tmp, r.ptr - tmp);
+    return *this;
+}
+
+JsonWriter& JsonWriter::int_value(int64_t v) {
+    separate();
+    char tmp[24];
+    auto r = std::to_chars(tmp, tmp + sizeof(tmp), v);
+    buf.append(tmp, r.ptr - tmp);
+    return *this;
+}
+
+JsonWriter& JsonWriter::bool_value(bool v) {
+    separate();
+    if (v) buf.append("true", 4);
+    else buf.append("false", 5);
+    return *this;
+}
+
+// Shortest round-trip form, with ".0" kept on whole numbers as dump() does.
+JsonWriter& JsonWriter::double_value(double v) {
+    if (!std::isfinite(v)) return null_value();
+    separate();
+    char tmp[32];
+    auto r = std::to_chars(tmp, tmp + sizeof(tmp), v);
+    buf.append(tmp, r.ptr - tmp);
+    if (!std::memchr(tmp, '.', r.ptr - tmp) && !std::memchr(tmp, 'e', r.ptr - tmp))
+        buf.append(".0", 2);
+    return *this;
+}
+
+JsonWriter& JsonWriter::null_value() {
+    separate();
+    buf.append("null", 4);
+    return *this;
+}
+
+JsonWriter& JsonWriter::json_value(const json &v) {
+    separate();
+    buf += v.dump();
+    return *this;
+}
+
+JsonWriter& JsonWriter::raw_value(const char *text, size_t n) {
+    separate();
+    buf.append(text, n);
+    return *this;
+}
@@ -0,0 +1,166 @@
+#include "../include/logger.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace logger {
+namespace {
+
+const size_t RING_SLOTS = 512;   // power of two
+const auto DRAIN_INTERVAL = std::chrono::milliseconds(2);
+
+struct Slot {
+    LogLevel level;
+    uint8_t len;
+    char text[MAX_LINE];
+};
+
+// Single producer (the owning thread), single consumer (whoever holds
+// drain_mtx). head and tail only grow; slot i lives at i % RING_SLOTS.
+struct Ring {
+    alignas(64) std::atomic<uint64_t> head{0};
+    alignas(64) std::atomic<uint64_t> tail{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> orphaned{false};   // owning thread has exited
+    Slot slots[RING_SLOTS];
+};
+
+std::mutex registry_mtx;                  // guards rings
+std::vector<std::unique_ptr<Ring>> rings;
+std::mutex drain_mtx;                     // one consumer at a time
+std::once_flag started;
+std::thread drainer;
+std::atomic<uint64_t> dropped_total{0};  // dropped lines of rings already removed
+std::mutex stop_mtx;
+std::condition_variable stop_cv;
+bool stopping = false;
+uint64_t dropped_reported = 0;
+
+const char* prefix(LogLevel level) {
+    switch (level) {
+        case LogLevel::DEBUG: return "[DEBUG] ";
+        case LogLevel::INFO: return "[INFO] ";
+        case LogLevel::WARN: return "[WARN] ";
+        case LogLevel::ERROR: return "[ERROR] ";
+    }
+    return "";
+}
+
+// Copies every ready line out of the rings and writes them in two
+// batches, one per stream. Rings of exited threads go once empty.
+void drain_all() {
+    std::lock_guard<std::mutex> drain_lock(drain_mtx);
+    std::string out, err;
+    uint64_t lost;
+    {
+        std::lock_guard<std::mutex> lock(registry_mtx);
+        for (auto it = rings.begin(); it != rings.end();) {
+            Ring &r = **it;
+            bool orphaned = r.orphaned.load(std::memory_order_acquire);
+            uint64_t tail = r.tail.load(std::memory_order_relaxed);
+            uint64_t head = r.head.load(std::memory_order_acquire);
+            for (; tail != head; ++tail) {
+                const Slot &s = r.slots[tail & (RING_SLOTS - 1)];
+                std::string &dst = s.level >= LogLevel::WARN ? err : out;
+                dst += prefix(s.level);
+                dst.append(s.text, s.len);
+                dst.push_back('\n');
+            }
+            r.tail.store(tail, std::memory_order_release);
+            if (orphaned) {
+                dropped_total.fetch_add(r.dropped.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                it = rings.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        lost = dropped_total.load(std::memory_order_relaxed);
+        for (auto &r : rings) lost += r->dropped.load(std::memory_order_relaxed);
+    }
+    if (lost > dropped_reported) {
+        err += "[WARN] logger dropped " + std::to_string(lost - dropped_reported) + " line(s)\n";
+        dropped_reported = lost;
+    }
+    if (!out.empty()) { fwrite(out.data(), 1, out.size(), stdout); fflush(stdout); }
+    if (!err.empty()) { fwrite(err.data(), 1, err.size(), stderr); fflush(stderr); }
+}
+
+void drain_loop() {
+    std::unique_lock<std::mutex> lock(stop_mtx);
+    while (!stopping) {
+        lock.unlock();
+        drain_all();
+        lock.lock();
+        stop_cv.wait_for(lock, DRAIN_INTERVAL, [] { return stopping; });
+    }
+}
+
+void stop() {
+    {
+        std::lock_guard<std::mutex> lock(stop_mtx);
+        stopping = true;
+    }
+    stop_cv.notify_all();
+    if (drainer.joinable()) drainer.join();
+    drain_all();
+}
+
+void start() {
+    drainer = std::thread(drain_loop);
+    std::atexit(stop);
+}
+
+// Registers the calling thread's ring on first use and hands it to the
+// drain thread when the thread exits.
+struct ThreadRing {
+    Ring *ring;
+    ThreadRing() {
+        std::call_once(started, start);
+        auto r = std::make_unique<Ring>();
+        ring = r.get();
+        std::lock_guard<std::mutex> lock(registry_mtx);
+        rings.push_back(std::move(r));
+    }
+    ~ThreadRing() { ring->orphaned.store(true, std::memory_order_release); }
+};
+
+} // namespace
+
+void write(LogLevel level, const char *fmt, ...) {
+    thread_local ThreadRing mine;
+    Ring &r = *mine.ring;
+    uint64_t head = r.head.load(std::memory_order_relaxed);
+    if (head - r.tail.load(std::memory_order_acquire) >= RING_SLOTS) {
+        r.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Slot &s = r.slots[head & (RING_SLOTS - 1)];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(s.text, MAX_LINE, fmt, ap);
+    va_end(ap);
+    s.level = level;
+    s.len = static_cast<uint8_t>(n < 0 ? 0 : n >= static_cast<int>(MAX_LINE) ? MAX_LINE - 1 : n);
+    r.head.store(head + 1, std::memory_order_release);
+}
+
+void flush() {
+    drain_all();
+}
+
+uint64_t dropped() {
+    std::lock_guard<std::mutex> lock(registry_mtx);
+    uint64_t n = dropped_total.load(std::memory_order_relaxed);
+    for (auto &r : rings) n += r->dropped.load(std::memory_order_relaxed);
+    return n;
+}
+
+} // namespace logger
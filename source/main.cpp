@@ -14,7 +14,6 @@ UserOperations* g_user_ops = nullptr;
 DirOperations* g_dir_ops = nullptr;
 FileOperations* g_file_ops = nullptr;
 SessionManager* g_session_mgr = nullptr;
-DirNode* g_root_dir = nullptr;
 std::unordered_map<uint32_t, FileEntry>* g_inode_table = nullptr;
 
 int main(int argc, char* argv[]) {
@@ -46,14 +45,14 @@ int main(int argc, char* argv[]) {
     // -----------------------
     // Step 2: Initialize core components
     // -----------------------
-    g_root_dir = new DirNode();
+    g_dir_tree = new DirectoryTree();
     g_fbm = new FreeBlockManager();
     g_inode_table = new std::unordered_map<uint32_t, FileEntry>();
     g_user_mgr = new UserManager();
     g_session_mgr = new SessionManager(g_user_mgr);
     g_user_ops = new UserOperations(g_user_mgr, g_session_mgr);
-    g_dir_ops = new DirOperations(g_root_dir);
-    g_file_ops = new FileOperations(g_root_dir, g_fbm, g_inode_table);
+    g_dir_ops = new DirOperations(g_dir_tree->get_root(), g_dir_tree->entry_counts());
+    g_file_ops = new FileOperations(g_dir_tree->get_root(), g_fbm, g_inode_table, g_dir_tree->entry_counts());
 
     std::cout << "[INFO] Core components initialized successfully.\n";
 
@@ -61,7 +60,7 @@ int main(int argc, char* argv[]) {
     // Step 3: Start server (with persistence)
     // -----------------------
     std::string omni_file = "data/filesystem.omni";  // persistent FS file
-    server_init(omni_file, cfg.port);  // this handles load or admin creation internally
+    server_init(omni_file, cfg);  // this handles load or admin creation internally
 
     // -----------------------
     // Step 4: Cleanup (normally not reached)
@@ -72,7 +71,7 @@ int main(int argc, char* argv[]) {
     delete g_session_mgr;
     delete g_user_mgr;
     delete g_fbm;
-    delete g_root_dir;
+    delete g_dir_tree;
     delete g_inode_table;
 
     return 0;
@@ -0,0 +1,64 @@
+#include "../include/op_registry.hpp"
+#include <iostream>
+
+OpRegistry& OpRegistry::instance() {
+    static OpRegistry registry;
+    return registry;
+}
+
+// FNV-1a with the seed folded into the start state.
+uint64_t OpRegistry::hash(const char *s, size_t len, uint64_t seed) {
+    uint64_t h = 14695981039346656037ULL ^ (seed * 0x9E3779B97F4A7C15ULL);
+    for (size_t i = 0; i < len; ++i) {
+        h ^= static_cast<unsigned char>(s[i]);
+        h *= 1099511628211ULL;
+    }
+    return h ^ (h >> 29);
+}
+
+// Searches for a seed that puts every name in its own slot. With the
+// table at least four times the operation count a few tries suffice;
+// the table doubles if a run of seeds finds nothing.
+void OpRegistry::rebuild() {
+    size_t size = 16;
+    while (size < specs.size() * 4) size *= 2;
+    for (;; size *= 2) {
+        for (uint64_t s = 1; s <= 1000; ++s) {
+            std::vector<uint16_t> table(size, 0);
+            bool ok = true;
+            for (size_t i = 0; i < specs.size() && ok; ++i) {
+                const std::string &n = specs[i].name;
+                uint16_t &slot = table[hash(n.data(), n.size(), s) & (size - 1)];
+                if (slot) ok = false;
+                else slot = static_cast<uint16_t>(i + 1);
+            }
+            if (!ok) continue;
+            slots.swap(table);
+            seed = s;
+            mask = size - 1;
+            return;
+        }
+    }
+}
+
+bool OpRegistry::add(OpSpec spec) {
+    if (!spec.handler || find(spec.name)) {
+        std::cerr << "[ERROR] Operation '" << spec.name << "' registered twice or without a handler\n";
+        return false;
+    }
+    specs.push_back(std::move(spec));
+    rebuild();
+    return true;
+}
+
+const OpSpec* OpRegistry::find(const std::string &name) const {
+    if (slots.empty()) return nullptr;
+    uint16_t slot = slots[hash(name.data(), name.size(), seed) & mask];
+    if (!slot) return nullptr;
+    const OpSpec &spec = specs[slot - 1];
+    return spec.name == name ? &spec : nullptr;
+}
+
+OpRegistrar::OpRegistrar(OpSpec spec) {
+    OpRegistry::instance().add(std::move(spec));
+}
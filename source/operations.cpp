@@ -4,9 +4,16 @@
 #include "../include/file_ops.hpp"
 #include "../include/session_manager.hpp"
 #include "../include/odf_types.hpp"
+#include "../include/globals.hpp"
+#include "../include/server.hpp"
+#include "../include/op_registry.hpp"
+#include "../include/request_arena.hpp"
+#include "../include/logger.hpp"
 #include "nlohmann/json.hpp"
 using json = nlohmann::json;
 #include <iostream>
+#include <shared_mutex>
+#include <algorithm>
 
 // extern globals (you must define these in your program startup)
 extern UserOperations* g_user_ops;     // pointer to UserOperations instance
@@ -18,7 +25,7 @@ extern SessionManager* g_session_mgr;  // pointer to SessionManager instance
 static int ofs_code_to_int(OFSErrorCodes c) {
     return static_cast<int32_t>(c);
 }
-static std::string ofs_code_to_message(OFSErrorCodes c) {
+std::string ofs_code_to_message(OFSErrorCodes c) {
     switch(c) {
         case OFSErrorCodes::SUCCESS: return "Success";
         case OFSErrorCodes::ERROR_NOT_FOUND: return "Not found";
@@ -32,299 +39,520 @@ static std::string ofs_code_to_message(OFSErrorCodes c) {
         case OFSErrorCodes::ERROR_INVALID_SESSION: return "Invalid session";
         case OFSErrorCodes::ERROR_DIRECTORY_NOT_EMPTY: return "Directory not empty";
         case OFSErrorCodes::ERROR_INVALID_OPERATION: return "Invalid operation";
+        case OFSErrorCodes::ERROR_SERVER_BUSY: return "Server busy";
+        case OFSErrorCodes::ERROR_QUEUE_TIMEOUT: return "Request timed out in queue";
+        case OFSErrorCodes::ERROR_THROTTLED: return "Rate limit exceeded";
         default: return "Unknown error";
     }
 }
 
-json dispatch_operation(const json &req) {
-    json res;
-    std::string op = req.value("operation", "");
-    std::string req_id = req.value("request_id", "");
-    std::string session_id = req.value("session_id", "");
-
-    // session pointer (NULL for no session)
-    SessionInfo* sess = nullptr;
-    if (!session_id.empty()) sess = g_session_mgr->get_session(session_id);
-
-    // allow only user_login without a valid session
-    if (op != "user_login" && sess == nullptr) {
-        res["status"] = "error";
-        res["operation"] = op;
-        res["request_id"] = req_id;
-        res["code"] = ofs_code_to_int(OFSErrorCodes::ERROR_INVALID_SESSION);
-        res["error_message"] = ofs_code_to_message(OFSErrorCodes::ERROR_INVALID_SESSION);
-        return res;
+json throttled_response(const RequestArgs &args, uint32_t retry_after_ms) {
+    return {{"status", "error"},
+            {"code", ofs_code_to_int(OFSErrorCodes::ERROR_THROTTLED)},
+            {"error_message", ofs_code_to_message(OFSErrorCodes::ERROR_THROTTLED)},
+            {"retry_after_ms", retry_after_ms},
+            {"operation", args.operation},
+            {"request_id", args.request_id}};
+}
+
+static const size_t MAX_BATCH_OPS = 10000;
+
+// Streaming transfers move at most this much per request, so neither side
+// ever holds more than one chunk of a file for them.
+static const size_t STREAM_DEFAULT_CHUNK = 64 * 1024;
+static const size_t STREAM_MAX_CHUNK = 1024 * 1024;
+
+// A chunk carried in a JSON string must not end inside a UTF-8 sequence;
+// returns the length to send, leaving a cut character for the next chunk.
+static size_t utf8_safe_length(const std::vector<char> &buf) {
+    size_t n = buf.size();
+    for (size_t back = 1; back <= 4 && back <= n; ++back) {
+        unsigned char c = static_cast<unsigned char>(buf[n - back]);
+        if ((c & 0xC0) == 0x80) continue;          // continuation byte
+        size_t need = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+        return need > back ? n - back : n;
     }
+    return n;
+}
 
-    // ----------------------
-    // USER OPERATIONS
-    // ----------------------
-    if (op == "user_login") {
-    json payload = req.value("payload", json::object());
-    std::string username = payload.value("username", "");
-    std::string password = payload.value("password", "");
+// Anything carrying a framed payload is bulk; otherwise the operation's
+// spec decides. Unknown operations are answered from the metadata lane.
+Lane operation_lane(const std::string &op, bool has_payload) {
+    if (has_payload) return Lane::BULK;
+    const OpSpec *spec = OpRegistry::instance().find(op);
+    return spec ? spec->lane : Lane::METADATA;
+}
 
-    std::cout << "[DEBUG dispatch_operation] login attempt, username='" 
-              << username << "', password='" << password << "'\n";
+// ===================== DISPATCH =====================
+// Opens the response object and writes everything but "data".
+static void write_envelope(JsonWriter &out, const std::string &op, const RequestArgs &args,
+                           OFSErrorCodes c, const std::string &error_message) {
+    out.begin_object();
+    out.key("status").string_value(c == OFSErrorCodes::SUCCESS ? "success" : "error");
+    out.key("code").int_value(ofs_code_to_int(c));
+    if (c != OFSErrorCodes::SUCCESS)
+        out.key("error_message").string_value(error_message.empty() ? ofs_code_to_message(c) : error_message);
+    out.key("operation").string_value(op);
+    out.key("request_id").string_value(args.request_id);
+}
 
-    std::string new_session;
-    OFSErrorCodes c = g_user_ops->user_login(username, password, new_session);
-    
+static void write_response(JsonWriter &out, const std::string &op, const RequestArgs &args,
+                           OFSErrorCodes c, const std::string &error_message) {
+    write_envelope(out, op, args, c, error_message);
+    out.end_object();
+}
 
-    if (c == OFSErrorCodes::SUCCESS) {
-        res["status"] = "success";
-        res["data"] = { {"session_id", new_session} };
-        res["code"] = ofs_code_to_int(c);
-    } else {
-        res["status"] = "error";
-        res["error_message"] = ofs_code_to_message(c);
-        res["code"] = ofs_code_to_int(c);
-    }
-    res["operation"] = op; 
-    res["request_id"] = req_id;
-    return res;
+void write_error_response(JsonWriter &out, const RequestArgs &args, int32_t code, const std::string &message) {
+    out.begin_object();
+    out.key("status").string_value("error");
+    out.key("code").int_value(code);
+    out.key("error_message").string_value(message);
+    out.key("operation").string_value(args.operation);
+    out.key("request_id").string_value(args.request_id);
+    out.end_object();
 }
 
+static const char* param_type_name(ParamType t) {
+    switch (t) {
+        case ParamType::STRING: return "a string";
+        case ParamType::UINT: return "a non-negative integer";
+        case ParamType::BOOL: return "a boolean";
+        case ParamType::OBJECT: return "an object";
+        case ParamType::ARRAY: return "an array";
+    }
+    return "valid";
+}
 
-    if (op == "user_logout") {
-        // session_id must be provided
-        OFSErrorCodes c = g_user_ops->user_logout(session_id);
-        if (c == OFSErrorCodes::SUCCESS) {
-            res["status"] = "success";
-            res["code"] = ofs_code_to_int(c);
-        } else {
-            res["status"] = "error";
-            res["error_message"] = ofs_code_to_message(c);
-            res["code"] = ofs_code_to_int(c);
+// Types were checked while parsing; only the verdict is looked at here.
+static bool check_params(const OpSpec &spec, const RequestArgs &args, std::string &error_msg) {
+    for (const auto &p : spec.params) {
+        if (args.bad(p.field)) {
+            error_msg = std::string("Parameter '") + field_name(p.field) + "' must be " +
+                        param_type_name(field_type(p.field));
+            return false;
+        }
+        if (p.required && !args.has(p.field)) {
+            error_msg = std::string("Missing parameter: ") + field_name(p.field);
+            return false;
         }
-        res["operation"] = op; res["request_id"] = req_id;
-        return res;
     }
+    return true;
+}
 
-    if (op == "user_create") {
-        std::string username = req.value("username", "");
-        std::string password_hash = req.value("password_hash", "");
-        UserRole role = static_cast<UserRole>(req.value("role", 0));
-        OFSErrorCodes c = g_user_ops->user_create(session_id, username, password_hash, role);
-        if (c == OFSErrorCodes::SUCCESS) res["status"]="success"; else { res["status"]="error"; res["error_message"]=ofs_code_to_message(c); }
-        res["code"] = ofs_code_to_int(c);
-        res["operation"]=op; res["request_id"]=req_id;
-        return res;
+// Checks role and parameters, runs the handler and writes the response
+// into out.response. The caller has checked the session and holds
+// whatever tree lock the spec asks for.
+static OFSErrorCodes run_spec(ResponseBuffers &out, const OpSpec &spec, OpContext &ctx) {
+    out.data.clear();
+    ctx.data_out = &out.data;
+    json data;
+    OFSErrorCodes c;
+    if (spec.admin_only && (!ctx.session || ctx.session->user.role != UserRole::ADMIN)) {
+        c = OFSErrorCodes::ERROR_PERMISSION_DENIED;
+    } else if (!check_params(spec, ctx.args, ctx.error_message)) {
+        c = OFSErrorCodes::ERROR_INVALID_OPERATION;
+    } else {
+        c = spec.handler(ctx, data);
+    }
+    write_envelope(out.response, spec.name, ctx.args, c, ctx.error_message);
+    if (c == OFSErrorCodes::SUCCESS) {
+        if (!out.data.empty()) out.response.key("data").raw_value(out.data.str().data(), out.data.size());
+        else if (!data.is_null()) out.response.key("data").json_value(data);
     }
+    out.response.end_object();
+    return c;
+}
+
+static void unknown_operation(JsonWriter &out, const RequestArgs &args) {
+    write_response(out, args.operation, args, OFSErrorCodes::ERROR_INVALID_OPERATION,
+                   "Unknown operation: " + args.operation);
+}
+
+json dispatch_operation(const json &req) {
+    RequestArgs args;
+    args_from_json(req, args);
+    ResponseBuffers out;
+    dispatch_operation(out, args, &req, nullptr, nullptr);
+    return json::parse(out.response.str());
+}
+
+void dispatch_operation(ResponseBuffers &out, const RequestArgs &args, const json *dom,
+                        std::vector<char> *payload_in,
+                        std::shared_ptr<const std::vector<char>> *payload_out,
+                        const Request *origin) {
+    out.response.clear();
+    const OpSpec *spec = OpRegistry::instance().find(args.operation);
+
+    // snapshot of the caller's session (only valid when has_session)
+    SessionInfo sess;
+    bool has_session = !args.session_id.empty() && g_session_mgr->get_session(args.session_id, sess);
+    // Unknown operations count as needing a session, so clients without
+    // one get INVALID_SESSION as they always have.
+    if ((!spec || spec->needs_session) && !has_session)
+        return write_response(out.response, args.operation, args, OFSErrorCodes::ERROR_INVALID_SESSION, "");
+    if (!spec) return unknown_operation(out.response, args);
+
+    std::shared_lock<std::shared_mutex> tree_read(g_dir_tree->mutex(), std::defer_lock);
+    std::unique_lock<std::shared_mutex> tree_write(g_dir_tree->mutex(), std::defer_lock);
+    if (spec->tree == TreeAccess::WRITE) tree_write.lock();
+    else if (spec->tree == TreeAccess::READ) tree_read.lock();
+
+    OpContext ctx{args, dom, has_session ? &sess : nullptr, origin, payload_in, payload_out, nullptr, ""};
+    run_spec(out, *spec, ctx);
+}
+
+// ===================== USER OPERATIONS =====================
+static OFSErrorCodes op_user_login(OpContext &ctx, json &data) {
+    const std::string &username = ctx.args.username;
+    const std::string &password = ctx.args.password;
+
+    LOG_DEBUG("dispatch_operation: login attempt, username='%s'", username.c_str());
+
+    std::string new_session;
+    OFSErrorCodes c = g_user_ops->user_login(username, password, new_session);
+    if (c == OFSErrorCodes::SUCCESS) data = { {"session_id", new_session} };
+    return c;
+}
+
+static OFSErrorCodes op_user_logout(OpContext &ctx, json &) {
+    return g_user_ops->user_logout(ctx.args.session_id);
+}
+
+static OFSErrorCodes op_user_create(OpContext &ctx, json &) {
+    UserRole role = static_cast<UserRole>(ctx.args.role);
+    return g_user_ops->user_create(ctx.args.session_id, ctx.args.username, ctx.args.password_hash, role);
+}
+
+static OFSErrorCodes op_user_delete(OpContext &ctx, json &) {
+    return g_user_ops->user_delete(ctx.args.session_id, ctx.args.username);
+}
 
-    if (op == "user_delete") {
-        std::string username = req.value("username", "");
-        OFSErrorCodes c = g_user_ops->user_delete(session_id, username);
-        if (c == OFSErrorCodes::SUCCESS) res["status"]="success"; else { res["status"]="error"; res["error_message"]=ofs_code_to_message(c); }
-        res["code"] = ofs_code_to_int(c);
-        res["operation"]=op; res["request_id"]=req_id;
-        return res;
+static OFSErrorCodes op_user_list(OpContext &ctx, json &data) {
+    std::vector<UserInfo> users;
+    OFSErrorCodes c = g_user_ops->user_list(ctx.args.session_id, users);
+    if (c != OFSErrorCodes::SUCCESS) return c;
+    json uarr = json::array();
+    for (const auto &u : users) {
+        uarr.push_back({
+            {"username", std::string(u.username)},
+            {"role", static_cast<uint32_t>(u.role)},
+            {"created_time", u.created_time},
+            {"last_login", u.last_login},
+            {"is_active", u.is_active}
+        });
     }
+    data = { {"users", uarr} };
+    return c;
+}
 
-    if (op == "user_list") {
-        std::vector<UserInfo> users;
-        OFSErrorCodes c = g_user_ops->user_list(session_id, users);
-        if (c == OFSErrorCodes::SUCCESS) {
-            json uarr = json::array();
-            for (const auto &u : users) {
-                uarr.push_back({
-                    {"username", std::string(u.username)},
-                    {"role", static_cast<uint32_t>(u.role)},
-                    {"created_time", u.created_time},
-                    {"last_login", u.last_login},
-                    {"is_active", u.is_active}
-                });
-            }
-            res["status"]="success";
-            res["data"] = { {"users", uarr} };
-        } else {
-            res["status"]="error";
-            res["error_message"]=ofs_code_to_message(c);
-        }
-        res["code"]=ofs_code_to_int(c);
-        res["operation"]=op; res["request_id"]=req_id;
-        return res;
+// ===================== DIRECTORY OPERATIONS =====================
+static OFSErrorCodes op_dir_create(OpContext &ctx, json &) {
+    return g_dir_ops->dir_create(ctx.args.path);
+}
+
+static OFSErrorCodes op_dir_delete(OpContext &ctx, json &) {
+    return g_dir_ops->dir_delete(ctx.args.path);
+}
+
+static OFSErrorCodes op_dir_exists(OpContext &ctx, json &data) {
+    data = { {"exists", g_dir_ops->dir_exists(ctx.args.path)} };
+    return OFSErrorCodes::SUCCESS;
+}
+
+static OFSErrorCodes op_dir_list(OpContext &ctx, json &) {
+    JsonWriter &out = *ctx.data_out;
+    out.begin_object().key("entries").begin_array();
+    g_dir_ops->dir_list(ctx.args.path, [&out](const std::string &name, bool is_dir) {
+        out.begin_string().string_chars(name);
+        if (is_dir) out.string_chars("/", 1);
+        out.end_string();
+    });
+    out.end_array().end_object();
+    return OFSErrorCodes::SUCCESS;
+}
+
+// ===================== FILE OPERATIONS =====================
+// The path is checked under the shared lock, then the block is taken
+// before the exclusive one and handed back if the create still fails, so
+// workers only meet in the allocator's own groups.
+static OFSErrorCodes op_file_create(OpContext &ctx, json &) {
+    OFSErrorCodes c;
+    {
+        std::shared_lock<std::shared_mutex> tree_read(g_dir_tree->mutex(), std::defer_lock);
+        if (!ctx.tree_held) tree_read.lock();
+        c = g_file_ops->check_create(ctx.args.path);
+    }
+    if (c != OFSErrorCodes::SUCCESS) return c;
+    int blk = g_fbm->allocate_block();
+    if (blk < 0) return OFSErrorCodes::ERROR_NO_SPACE;
+    {
+        std::unique_lock<std::shared_mutex> tree_write(g_dir_tree->mutex(), std::defer_lock);
+        if (!ctx.tree_held) tree_write.lock();
+        c = g_file_ops->file_create(ctx.args.path, ctx.args.size, static_cast<uint32_t>(blk));
+    }
+    if (c != OFSErrorCodes::SUCCESS) g_fbm->free_block(blk);
+    return c;
+}
+
+static OFSErrorCodes op_file_read(OpContext &ctx, json &data) {
+    // snapshot of the contents; a later edit copies instead of touching it
+    auto buf = g_file_ops->file_read_shared(ctx.args.path);
+    if (!buf || buf->empty()) return OFSErrorCodes::ERROR_NOT_FOUND;
+    if (ctx.payload_out) {
+        data = { {"size", buf->size()} };
+        *ctx.payload_out = std::move(buf);
+    } else {
+        data["content"] = std::string(buf->begin(), buf->end());
     }
+    return OFSErrorCodes::SUCCESS;
+}
 
-    // ----------------------
-    // DIRECTORY OPERATIONS
-    // ----------------------
-    if (op == "dir_create") {
-        std::string path = req.value("path", "");
-        OFSErrorCodes c = g_dir_ops->dir_create(path);
-        if (c==OFSErrorCodes::SUCCESS) res["status"]="success"; else { res["status"]="error"; res["error_message"]=ofs_code_to_message(c); }
-        res["code"]=ofs_code_to_int(c);
-        res["operation"]=op; res["request_id"]=req_id;
-        return res;
+static OFSErrorCodes op_file_edit(OpContext &ctx, json &) {
+    if (ctx.payload_in && !ctx.args.has(Field::DATA)) {
+        g_file_ops->file_edit(ctx.args.path, *ctx.payload_in, ctx.args.index); // raw bytes, no copy
+    } else {
+        std::vector<char> data(ctx.args.data.begin(), ctx.args.data.end());
+        g_file_ops->file_edit(ctx.args.path, data, ctx.args.index); // void
     }
+    return OFSErrorCodes::SUCCESS;
+}
+
+// Pull-based chunked read: each request names the offset it wants next and
+// gets at most one chunk back, so the client paces the transfer.
+static OFSErrorCodes op_file_read_stream(OpContext &ctx, json &data) {
+    uint64_t offset = ctx.args.offset;
+    size_t chunk = ctx.args.chunk_size ? std::min<uint64_t>(ctx.args.chunk_size, STREAM_MAX_CHUNK)
+                                       : STREAM_DEFAULT_CHUNK;
 
-    if (op == "dir_delete") {
-        std::string path = req.value("path", "");
-        OFSErrorCodes c = g_dir_ops->dir_delete(path);
-        if (c==OFSErrorCodes::SUCCESS) res["status"]="success"; else { res["status"]="error"; res["error_message"]=ofs_code_to_message(c); }
-        res["code"]=ofs_code_to_int(c);
-        res["operation"]=op; res["request_id"]=req_id;
-        return res;
+    auto buf = std::make_shared<std::vector<char>>();
+    uint64_t file_size = 0;
+    OFSErrorCodes c = g_file_ops->file_read_range(ctx.args.path, offset, chunk, *buf, file_size);
+    if (c != OFSErrorCodes::SUCCESS) return c;
+
+    if (!ctx.payload_out) buf->resize(utf8_safe_length(*buf));
+    uint64_t next = std::min(offset, file_size) + buf->size();
+    data = { {"offset", offset}, {"length", buf->size()}, {"next_offset", next},
+             {"size", file_size}, {"eof", next >= file_size} };
+    if (ctx.payload_out) *ctx.payload_out = std::move(buf);
+    else data["content"] = std::string(buf->begin(), buf->end());
+    return c;
+}
+
+// Chunked write: "data" (or the framed payload) is stored at "offset", which
+// must be at or before the current end; "last" cuts the file after it.
+static OFSErrorCodes op_file_write_stream(OpContext &ctx, json &data) {
+    uint64_t offset = ctx.args.offset;
+    const char *bytes = ctx.args.data.data();
+    size_t len = ctx.args.data.size();
+    if (ctx.payload_in && !ctx.args.has(Field::DATA)) {
+        bytes = ctx.payload_in->data();
+        len = ctx.payload_in->size();
     }
+    if (len > STREAM_MAX_CHUNK) return OFSErrorCodes::ERROR_INVALID_OPERATION;
+
+    uint64_t file_size = 0;
+    OFSErrorCodes c = g_file_ops->file_write_range(ctx.args.path, offset, bytes, len, ctx.args.last, file_size);
+    if (c == OFSErrorCodes::SUCCESS) data = { {"next_offset", offset + len}, {"size", file_size} };
+    return c;
+}
+
+static OFSErrorCodes op_file_truncate(OpContext &ctx, json &) {
+    g_file_ops->file_truncate(ctx.args.path, ctx.args.size); // void
+    return OFSErrorCodes::SUCCESS;
+}
 
-    if (op == "dir_exists") {
-        std::string path = req.value("path", "");
-        bool ex = g_dir_ops->dir_exists(path);
-        res["status"] = "success";
-        res["data"] = { {"exists", ex} };
-        res["code"] = 0;
-        res["operation"]=op; res["request_id"]=req_id;
-        return res;
+static OFSErrorCodes op_file_delete(OpContext &ctx, json &) {
+    uint32_t blk = 0;
+    OFSErrorCodes c;
+    {
+        std::unique_lock<std::shared_mutex> tree_write(g_dir_tree->mutex(), std::defer_lock);
+        if (!ctx.tree_held) tree_write.lock();
+        c = g_file_ops->file_delete(ctx.args.path, blk);
     }
+    if (c == OFSErrorCodes::SUCCESS) g_fbm->free_block(blk);
+    return c;
+}
+
+static OFSErrorCodes op_file_rename(OpContext &ctx, json &) {
+    g_file_ops->file_rename(ctx.args.old_path, ctx.args.new_path); // void
+    return OFSErrorCodes::SUCCESS;
+}
+
+static OFSErrorCodes op_file_exists(OpContext &ctx, json &data) {
+    data = { {"exists", g_file_ops->file_exists(ctx.args.path)} };
+    return OFSErrorCodes::SUCCESS;
+}
+
+// ===================== METADATA / STATS =====================
+static OFSErrorCodes op_get_metadata(OpContext &ctx, json &) {
+    FileMetadata meta = g_file_ops->get_metadata(ctx.args.path);
+    // If default-constructed path empty -> error
+    if (strlen(meta.path) == 0) return OFSErrorCodes::ERROR_NOT_FOUND;
+    ctx.data_out->begin_object()
+        .key("path").string_value(meta.path, strnlen(meta.path, sizeof(meta.path)))
+        .key("size").uint_value(meta.entry.size)
+        .key("blocks_used").uint_value(meta.blocks_used)
+        .key("actual_size").uint_value(meta.actual_size)
+        .key("owner").string_value(meta.entry.owner, strnlen(meta.entry.owner, sizeof(meta.entry.owner)))
+        .end_object();
+    return OFSErrorCodes::SUCCESS;
+}
+
+static OFSErrorCodes op_set_permissions(OpContext &ctx, json &) {
+    return g_file_ops->set_permissions(ctx.args.path, static_cast<uint32_t>(ctx.args.permissions));
+}
+
+static OFSErrorCodes op_get_stats(OpContext &ctx, json &) {
+    FSStats stats = g_file_ops->get_stats();
+    stats.total_users = static_cast<uint32_t>(g_user_mgr->user_count());
+    stats.active_sessions = static_cast<uint32_t>(g_session_mgr->session_count());
+    ctx.data_out->begin_object()
+        .key("total_size").uint_value(stats.total_size)
+        .key("used_space").uint_value(stats.used_space)
+        .key("free_space").uint_value(stats.free_space)
+        .key("total_files").uint_value(stats.total_files)
+        .key("total_directories").uint_value(stats.total_directories)
+        .key("total_users").uint_value(stats.total_users)
+        .key("active_sessions").uint_value(stats.active_sessions)
+        .key("fragmentation").double_value(stats.fragmentation)
+        .key("free_extents").uint_value(stats.free_extents)
+        .key("largest_free_extent").uint_value(stats.largest_free_extent)
+        .end_object();
+    return OFSErrorCodes::SUCCESS;
+}
 
-    if (op == "dir_list") {
-        std::string path = req.value("path", "");
-        auto list = g_dir_ops->dir_list(path);
-        res["status"]="success";
-        res["data"] = { {"entries", list} };
-        res["code"]=0;
-        res["operation"]=op; res["request_id"]=req_id;
-        return res;
+static OFSErrorCodes op_server_stats(OpContext &, json &data) {
+    data = {
+        {"connections_accepted", g_server_metrics.connections_accepted.load()},
+        {"connections_rejected", g_server_metrics.connections_rejected.load()},
+        {"connections_active", g_server_metrics.connections_active.load()},
+        {"requests_enqueued", g_server_metrics.requests_enqueued.load()},
+        {"requests_completed", g_server_metrics.requests_completed.load()},
+        {"requests_timed_out", g_server_metrics.requests_timed_out.load()},
+        {"backpressure_pauses", g_server_metrics.backpressure_pauses.load()},
+        {"requests_throttled", g_server_metrics.requests_throttled.load()},
+        {"queue_depth", requestQueue.size()},
+        {"queue_depth_control", requestQueue.size(Lane::CONTROL)},
+        {"queue_depth_metadata", requestQueue.size(Lane::METADATA)},
+        {"queue_depth_bulk", requestQueue.size(Lane::BULK)},
+        {"queue_capacity", requestQueue.capacity()}
+    };
+    return OFSErrorCodes::SUCCESS;
+}
+
+// ===================== BATCH =====================
+// Runs every entry of "operations" under the caller's session, holding the
+// tree lock once for the whole batch (exclusively if any entry writes).
+static OFSErrorCodes op_batch(OpContext &ctx, json &) {
+    const json &ops = ctx.dom->at("operations");
+    if (ops.size() > MAX_BATCH_OPS) {
+        ctx.error_message = "batch needs an \"operations\" array of at most " +
+                            std::to_string(MAX_BATCH_OPS) + " requests";
+        return OFSErrorCodes::ERROR_INVALID_OPERATION;
     }
 
- // ----------------------
-// FILE OPERATIONS
-// ----------------------
-if (op == "file_create") {
-    std::string path = req.value("path", "");
-    uint64_t size = req.value("size", 0ULL);
-    OFSErrorCodes c = g_file_ops->file_create(path, size);
-    if (c == OFSErrorCodes::SUCCESS) res["status"] = "success";
-    else { res["status"] = "error"; res["error_message"] = ofs_code_to_message(c); }
-    res["code"] = ofs_code_to_int(c); res["operation"] = op; res["request_id"] = req_id;
-    return res;
-}
-
-if (op == "file_read") {
-    std::string path = req.value("path", "");
-    std::vector<char> buf;
-    g_file_ops->file_read(path, buf); // now matches signature
-    if (!buf.empty()) {
-        res["status"] = "success";
-        res["data"] = { {"content", std::string(buf.begin(), buf.end())} };
-        res["code"] = 0;
-    } else {
-        res["status"] = "error";
-        res["error_message"] = ofs_code_to_message(OFSErrorCodes::ERROR_NOT_FOUND);
-        res["code"] = ofs_code_to_int(OFSErrorCodes::ERROR_NOT_FOUND);
+    const OpRegistry &registry = OpRegistry::instance();
+    std::pmr::vector<RequestArgs> entries(ops.size(), request_memory());
+    std::pmr::vector<const OpSpec*> specs(ops.size(), request_memory());
+    bool writes = false, reads = false;
+    for (size_t i = 0; i < ops.size(); ++i) {
+        args_from_json(ops[i], entries[i]);
+        const OpSpec *spec = specs[i] = registry.find(entries[i].operation);
+        if (!spec) continue;
+        writes = writes || spec->tree == TreeAccess::WRITE || spec->tree == TreeAccess::WRITE_SELF;
+        reads = reads || spec->tree == TreeAccess::READ;
     }
-    res["operation"] = op; res["request_id"] = req_id;
-    return res;
-}
-
-if (op == "file_edit") {
-    std::string path = req.value("path", "");
-    uint64_t index = req.value("index", 0ULL);
-    std::string data_str = req.value("data", "");
-    std::vector<char> data(data_str.begin(), data_str.end());
-    g_file_ops->file_edit(path, data, index); // void
-    res["status"] = "success";
-    res["code"] = 0;
-    res["operation"] = op; res["request_id"] = req_id;
-    return res;
-}
-
-if (op == "file_truncate") {
-    std::string path = req.value("path", "");
-    size_t new_size = req.value("size", 0ULL);
-    g_file_ops->file_truncate(path, new_size); // void
-    res["status"] = "success";
-    res["code"] = 0;
-    res["operation"] = op; res["request_id"] = req_id;
-    return res;
-}
-
-if (op == "file_delete") {
-    std::string path = req.value("path", "");
-    OFSErrorCodes c = g_file_ops->file_delete(path);
-    if (c == OFSErrorCodes::SUCCESS) res["status"] = "success";
-    else { res["status"] = "error"; res["error_message"] = ofs_code_to_message(c); }
-    res["code"] = ofs_code_to_int(c); res["operation"] = op; res["request_id"] = req_id;
-    return res;
-}
-
-if (op == "file_rename") {
-    std::string oldp = req.value("old_path", "");
-    std::string newp = req.value("new_path", "");
-    g_file_ops->file_rename(oldp, newp); // void
-    res["status"] = "success";
-    res["code"] = 0;
-    res["operation"] = op; res["request_id"] = req_id;
-    return res;
-}
-
-if (op == "file_exists") {
-    std::string path = req.value("path", "");
-    bool ex = g_file_ops->file_exists(path);
-    res["status"] = "success";
-    res["data"] = { {"exists", ex} };
-    res["code"] = 0; res["operation"] = op; res["request_id"] = req_id;
-    return res;
-}
-
-
-    // ----------------------
-    // METADATA / STATS
-    // ----------------------
-    if (op == "get_metadata") {
-        std::string path = req.value("path", "");
-        FileMetadata meta = g_file_ops->get_metadata(path); // assumed signature
-        // If default-constructed path empty -> error
-        if (strlen(meta.path) == 0) {
-            res["status"]="error";
-            res["error_message"]=ofs_code_to_message(OFSErrorCodes::ERROR_NOT_FOUND);
-            res["code"]=ofs_code_to_int(OFSErrorCodes::ERROR_NOT_FOUND);
+    std::shared_lock<std::shared_mutex> tree_read(g_dir_tree->mutex(), std::defer_lock);
+    std::unique_lock<std::shared_mutex> tree_write(g_dir_tree->mutex(), std::defer_lock);
+    if (writes) tree_write.lock();
+    else if (reads) tree_read.lock();
+
+    // Each entry's response is built in sub and copied into the results.
+    ResponseBuffers sub;
+    JsonWriter &out = *ctx.data_out;
+    out.begin_object().key("results").begin_array();
+    size_t executed = 0, failed = 0;
+    for (size_t i = 0; i < ops.size(); ++i) {
+        RequestArgs &args = entries[i];
+        args.session_id = ctx.args.session_id;
+        sub.response.clear();
+        OFSErrorCodes c = OFSErrorCodes::ERROR_INVALID_OPERATION;
+        if (!specs[i]) {
+            unknown_operation(sub.response, args);
+        } else if (!ops[i].is_object() || !specs[i]->batchable) {
+            write_response(sub.response, args.operation, args, c, "Not allowed in a batch");
         } else {
-            res["status"]="success";
-            res["data"] = {
-                {"path", std::string(meta.path)},
-                {"size", meta.entry.size},
-                {"blocks_used", meta.blocks_used},
-                {"actual_size", meta.actual_size},
-                {"owner", std::string(meta.entry.owner)}
-            };
-            res["code"]=0;
+            try {
+                OpContext sub_ctx{args, &ops[i], ctx.session, nullptr, nullptr, nullptr, nullptr, "", writes};
+                c = run_spec(sub, *specs[i], sub_ctx);
+            } catch (const std::exception &e) {
+                sub.response.clear();
+                write_error_response(sub.response, args, -500, e.what());
+            }
+        }
+        out.raw_value(sub.response.str().data(), sub.response.size());
+        ++executed;
+        if (c != OFSErrorCodes::SUCCESS) {
+            ++failed;
+            if (ctx.args.stop_on_error) break;
         }
-        res["operation"]=op; res["request_id"]=req_id;
-        return res;
     }
+    out.end_array().key("executed").uint_value(executed).key("failed").uint_value(failed).end_object();
+    return OFSErrorCodes::SUCCESS;
+}
 
-    if (op == "set_permissions") {
-        std::string path = req.value("path", "");
-        uint32_t perms = req.value("permissions", 0u);
-        OFSErrorCodes c = g_file_ops->set_permissions(path, perms);
-        if (c==OFSErrorCodes::SUCCESS) res["status"]="success"; else { res["status"]="error"; res["error_message"]=ofs_code_to_message(c); }
-        res["code"]=ofs_code_to_int(c); res["operation"]=op; res["request_id"]=req_id;
-        return res;
-    }
+// ===================== REGISTRATION =====================
+// File contents are bulk; session and server housekeeping is control;
+// the rest is metadata. Namespace reads may run in parallel, anything
+// that mutates the tree needs it to itself.
+static bool register_builtin_operations() {
+    const bool REQ = true, OPT = false;
+    const ParamSpec path{Field::PATH, REQ};
+    OpSpec table[] = {
+        {"user_login", op_user_login, {{Field::PAYLOAD, REQ}, {Field::USERNAME, OPT}, {Field::PASSWORD, OPT}},
+         false, false, TreeAccess::NONE, Lane::CONTROL, false},
+        {"user_logout", op_user_logout, {}, true, false, TreeAccess::NONE, Lane::CONTROL},
+        {"user_create", op_user_create, {{Field::USERNAME, REQ},
+                                         {Field::PASSWORD_HASH, REQ},
+                                         {Field::ROLE, OPT}}, true, true},
+        {"user_delete", op_user_delete, {{Field::USERNAME, REQ}}, true, true},
+        {"user_list", op_user_list, {}, true, true},
 
-    if (op == "get_stats") {
-        FSStats stats = g_file_ops->get_stats();
-        res["status"]="success";
-        res["data"] = {
-            {"total_size", stats.total_size},
-            {"used_space", stats.used_space},
-            {"free_space", stats.free_space},
-            {"total_files", stats.total_files},
-            {"total_directories", stats.total_directories},
-            {"total_users", stats.total_users},
-            {"active_sessions", stats.active_sessions},
-            {"fragmentation", stats.fragmentation}
-        };
-        res["code"]=0; res["operation"]=op; res["request_id"]=req_id;
-        return res;
-    }
+        {"dir_create", op_dir_create, {path}, true, false, TreeAccess::WRITE},
+        {"dir_delete", op_dir_delete, {path}, true, false, TreeAccess::WRITE},
+        {"dir_exists", op_dir_exists, {path}, true, false, TreeAccess::READ},
+        {"dir_list", op_dir_list, {path}, true, false, TreeAccess::READ},
 
-    // Unknown operation
-    res["status"] = "error";
-    res["operation"] = op;
-    res["request_id"] = req_id;
-    res["code"] = ofs_code_to_int(OFSErrorCodes::ERROR_INVALID_OPERATION);
-    res["error_message"] = "Unknown operation: " + op;
-    return res;
+        {"file_create", op_file_create, {path, {Field::SIZE, OPT}}, true, false, TreeAccess::WRITE_SELF},
+        {"file_read", op_file_read, {path}, true, false, TreeAccess::READ, Lane::BULK},
+        {"file_edit", op_file_edit, {path, {Field::INDEX, OPT}, {Field::DATA, OPT}},
+         true, false, TreeAccess::WRITE, Lane::BULK},
+        {"file_read_stream", op_file_read_stream, {path, {Field::OFFSET, OPT},
+                                                   {Field::CHUNK_SIZE, OPT}},
+         true, false, TreeAccess::READ, Lane::BULK},
+        {"file_write_stream", op_file_write_stream, {path, {Field::OFFSET, OPT},
+                                                     {Field::DATA, OPT},
+                                                     {Field::LAST, OPT}},
+         true, false, TreeAccess::WRITE, Lane::BULK},
+        {"file_truncate", op_file_truncate, {path, {Field::SIZE, OPT}},
+         true, false, TreeAccess::WRITE, Lane::BULK},
+        {"file_delete", op_file_delete, {path}, true, false, TreeAccess::WRITE_SELF},
+        {"file_rename", op_file_rename, {{Field::OLD_PATH, REQ}, {Field::NEW_PATH, REQ}},
+         true, false, TreeAccess::WRITE},
+        {"file_exists", op_file_exists, {path}, true, false, TreeAccess::READ},
+
+        {"get_metadata", op_get_metadata, {path}, true, false, TreeAccess::READ},
+        {"set_permissions", op_set_permissions, {path, {Field::PERMISSIONS, REQ}},
+         true, false, TreeAccess::WRITE},
+        {"get_stats", op_get_stats, {}, true, false, TreeAccess::READ},
+        {"server_stats", op_server_stats, {}, true, false, TreeAccess::NONE, Lane::CONTROL},
+
+        {"batch", op_batch, {{Field::OPERATIONS, REQ}, {Field::STOP_ON_ERROR, OPT}},
+         true, false, TreeAccess::NONE, Lane::METADATA, false},
+    };
+    OpRegistry &registry = OpRegistry::instance();
+    for (auto &spec : table) registry.add(std::move(spec));
+    return true;
 }
+
+static const bool builtins_registered = register_builtin_operations();
@@ -1,15 +1,50 @@
 #include "persistence_manager.hpp"
-#include <fstream>
+#include "io_backend.hpp"
 #include <vector>
 #include <cstring>
 #include <cstdint>
+#include <cstddef>
 #include <iostream>
-#include "include/dir_tree.hpp"  
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "include/dir_tree.hpp"
+
+// The fixed-size part of a FileEntry as stored in the container; a file's
+// content follows its entry as a length-prefixed byte run.
+static const size_t ENTRY_DISK_BYTES = offsetof(FileEntry, content);
+
+static void append_raw(std::vector<char> &buf, const void *p, size_t n) {
+    const char *c = static_cast<const char*>(p);
+    buf.insert(buf.end(), c, c + n);
+}
+
+// Bounds-checked cursor over a container image loaded into memory.
+struct ImageReader {
+    const std::vector<char> &image;
+    size_t pos = 0;
+
+    explicit ImageReader(const std::vector<char> &img) : image(img) {}
+
+    bool seek(uint64_t offset) {
+        if (offset > image.size()) return false;
+        pos = static_cast<size_t>(offset);
+        return true;
+    }
 
+    bool read(void *out, size_t n) {
+        if (image.size() - pos < n) return false;
+        std::memcpy(out, image.data() + pos, n);
+        pos += n;
+        return true;
+    }
+};
 
 // ====================================================
 // SHUTDOWN / SAVE FILESYSTEM
 // ====================================================
+// Every section is serialized into memory first, then all of them are
+// written in one batch (a single io_uring submission when available).
 bool PersistenceManager::fs_shutdown(
 const std::string &omni_path,
 OMNIHeader &header,
@@ -18,35 +53,42 @@ const DirectoryTree &dir_tree,
 const FreeBlockManager &fbm,
 std::string &error_msg)
 {
-std::ofstream ofs(omni_path, std::ios::binary | std::ios::in | std::ios::out);
-if (!ofs.is_open()) {
-ofs.open(omni_path, std::ios::binary | std::ios::out);
-if (!ofs.is_open()) {
-error_msg = "Failed to open .omni file for shutdown: " + omni_path;
-return false;
-}
-}
+if (header.user_table_offset < sizeof(OMNIHeader)) header.user_table_offset = 512;
 
+std::vector<char> users;
+if (!save_user_table(users, header, user_manager, error_msg)) return false;
 
-if (!save_header(ofs, header, error_msg)) return false;
-if (!save_user_table(ofs, header, user_manager, error_msg)) return false;
+std::vector<char> dirs;
+if (!save_directory_tree(dirs, dir_tree, error_msg)) return false;
 
-uint64_t dir_bytes = 0;
-if (!save_directory_tree(ofs, header, dir_tree, dir_bytes, error_msg)) return false;
-
-uint64_t fbm_offset = 0;
-if (!save_free_block_map(ofs, header, fbm, fbm_offset, error_msg)) return false;
+std::vector<char> fbm_bytes;
+if (!save_free_block_map(fbm_bytes, fbm, error_msg)) return false;
 
+uint64_t dir_offset = header.user_table_offset + static_cast<uint64_t>(header.max_users) * sizeof(UserInfo);
+uint64_t fbm_offset = dir_offset + dirs.size();
 header.file_state_storage_offset = static_cast<uint32_t>(fbm_offset);
 header.change_log_offset = 0;
 
-ofs.seekp(0, std::ios::beg);
-if (!ofs.good()) { error_msg = "Failed to seek header for rewrite"; ofs.close(); return false; }
-ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
-if (!ofs) { error_msg = "Failed to rewrite header"; ofs.close(); return false; }
-
-ofs.close();
-return true;
+std::vector<char> head;
+append_raw(head, &header, sizeof(header));
+
+int fd = open(omni_path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+if (fd < 0) { error_msg = "Failed to open .omni file for shutdown: " + omni_path; return false; }
+
+std::vector<IoSegment> segments = {
+    {0, head.data(), head.size()},
+    {header.user_table_offset, users.data(), users.size()},
+    {dir_offset, dirs.data(), dirs.size()},
+    {fbm_offset, fbm_bytes.data(), fbm_bytes.size()}
+};
+bool ok = io::pwrite_all(fd, segments, error_msg);
+// Drop whatever an older, larger image left behind.
+if (ok && ftruncate(fd, static_cast<off_t>(fbm_offset + fbm_bytes.size())) < 0) {
+    error_msg = "Failed to truncate .omni file";
+    ok = false;
+}
+close(fd);
+return ok;
 
 
 }
@@ -54,32 +96,13 @@ return true;
 // ====================================================
 // SAVE HELPERS
 // ====================================================
-bool PersistenceManager::save_header(std::ofstream &ofs, const OMNIHeader &header, std::string &error_msg) {
-ofs.seekp(0, std::ios::beg);
-ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
-if (!ofs) { error_msg = "Failed to write header"; return false; }
-return true;
-}
-
-bool PersistenceManager::save_user_table(std::ofstream &ofs, const OMNIHeader &header, const UserManager &user_manager, std::string &error_msg) {
+bool PersistenceManager::save_user_table(std::vector<char> &out, OMNIHeader &header, const UserManager &user_manager, std::string &error_msg) {
 std::vector<UserInfo> users = user_manager.save_users();
-uint64_t offset = header.user_table_offset;
-ofs.seekp(static_cast<std::streamoff>(offset), std::ios::beg);
-if (!ofs.good()) { error_msg = "Failed to seek to user_table_offset"; return false; }
+if (header.max_users < users.size()) header.max_users = static_cast<uint32_t>(users.size());
 
-
-size_t write_count = users.size();
-if (write_count > header.max_users) write_count = header.max_users;
-
-ofs.write(reinterpret_cast<const char*>(users.data()), sizeof(UserInfo) * write_count);
-if (!ofs) { error_msg = "Failed to write user entries"; return false; }
-
-size_t remaining = header.max_users - write_count;
-if (remaining > 0) {
-    std::vector<UserInfo> empty(remaining);
-    ofs.write(reinterpret_cast<const char*>(empty.data()), sizeof(UserInfo) * remaining);
-    if (!ofs) { error_msg = "Failed to write remaining empty user slots"; return false; }
-}
+users.resize(header.max_users); // remaining slots are written empty
+append_raw(out, users.data(), sizeof(UserInfo) * users.size());
+(void)error_msg;
 return true;
 
 
@@ -98,43 +121,35 @@ collect_dirnodes_recursive(c.second.get(), child_path, out);
 }
 }
 
-bool PersistenceManager::save_directory_tree(std::ofstream &ofs, const OMNIHeader &header, const DirectoryTree &dir_tree, uint64_t &out_directory_bytes_written, std::string &error_msg) {
-uint64_t offset = header.user_table_offset + static_cast<uint64_t>(header.max_users) * sizeof(UserInfo);
-ofs.seekp(static_cast<std::streamoff>(offset), std::ios::beg);
-if (!ofs.good()) { error_msg = "Failed to seek directory offset"; return false; }
-
-
+bool PersistenceManager::save_directory_tree(std::vector<char> &out, const DirectoryTree &dir_tree, std::string &error_msg) {
 std::vector<std::pair<std::string, DirNode*>> nodes;
 collect_dirnodes_recursive(dir_tree.get_root(), "/", nodes);
 
 uint32_t node_count = static_cast<uint32_t>(nodes.size());
-ofs.write(reinterpret_cast<const char*>(&node_count), sizeof(node_count));
-if (!ofs) { error_msg = "Failed to write directory node count"; return false; }
+append_raw(out, &node_count, sizeof(node_count));
 
 for (auto &p : nodes) {
     const std::string &path = p.first;
     DirNode* node = p.second;
 
     uint32_t path_len = static_cast<uint32_t>(path.size());
-    ofs.write(reinterpret_cast<const char*>(&path_len), sizeof(path_len));
-    ofs.write(path.data(), path_len);
+    append_raw(out, &path_len, sizeof(path_len));
+    append_raw(out, path.data(), path_len);
 
-    ofs.write(reinterpret_cast<const char*>(&node->entry), sizeof(node->entry));
+    append_raw(out, &node->entry, ENTRY_DISK_BYTES);
 
     uint32_t file_count = static_cast<uint32_t>(node->files.size());
-    ofs.write(reinterpret_cast<const char*>(&file_count), sizeof(file_count));
-    if (!ofs) { error_msg = "Failed writing directory files metadata"; return false; }
+    append_raw(out, &file_count, sizeof(file_count));
 
     for (auto &fe_pair : node->files) {
         const FileEntry &fe = fe_pair.second;
-        ofs.write(reinterpret_cast<const char*>(&fe), sizeof(fe));
-        if (!ofs) { error_msg = "Failed to write FileEntry"; return false; }
+        append_raw(out, &fe, ENTRY_DISK_BYTES);
+        uint64_t content_len = fe.content ? fe.content->size() : 0;
+        append_raw(out, &content_len, sizeof(content_len));
+        if (content_len) append_raw(out, fe.content->data(), content_len);
     }
 }
-
-std::streamoff pos = ofs.tellp();
-if (pos < 0) { error_msg = "Failed to get directory tree end"; return false; }
-out_directory_bytes_written = static_cast<uint64_t>(pos) - offset;
+(void)error_msg;
 return true;
 
 
@@ -143,29 +158,21 @@ return true;
 // ====================================================
 // FREE BLOCK MAP
 // ====================================================
-bool PersistenceManager::save_free_block_map(std::ofstream &ofs, const OMNIHeader &header, const FreeBlockManager &fbm, uint64_t &out_offset, std::string &error_msg) {
-ofs.seekp(0, std::ios::end);
-std::streamoff pos = ofs.tellp();
-if (pos < 0) { error_msg = "Failed to seek end for free block map"; return false; }
-uint64_t write_offset = static_cast<uint64_t>(pos);
-
-
+bool PersistenceManager::save_free_block_map(std::vector<char> &out, const FreeBlockManager &fbm, std::string &error_msg) {
 std::vector<bool> bits = fbm.to_vector_bool();
 uint64_t total_bits = bits.size();
 uint64_t num_bytes = (total_bits + 7) / 8;
 
-ofs.write(reinterpret_cast<const char*>(&total_bits), sizeof(total_bits));
+append_raw(out, &total_bits, sizeof(total_bits));
 uint64_t blk_size = fbm.block_size();
-ofs.write(reinterpret_cast<const char*>(&blk_size), sizeof(blk_size));
+append_raw(out, &blk_size, sizeof(blk_size));
 
 std::vector<uint8_t> bytes(static_cast<size_t>(num_bytes), 0);
 for (uint64_t i = 0; i < total_bits; ++i) {
     if (bits[i]) bytes[i / 8] |= (1 << (i % 8));
 }
-if (num_bytes > 0) ofs.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(num_bytes));
-if (!ofs) { error_msg = "Failed to write free block map"; return false; }
-
-out_offset = write_offset;
+append_raw(out, bytes.data(), bytes.size());
+(void)error_msg;
 return true;
 
 
@@ -174,6 +181,7 @@ return true;
 // ====================================================
 // LOAD FILESYSTEM
 // ====================================================
+// The whole container is read in one batch and parsed from memory.
 bool PersistenceManager::fs_load(
 const std::string &omni_path,
 OMNIHeader &header,
@@ -182,18 +190,25 @@ DirectoryTree &dir_tree,
 FreeBlockManager &fbm,
 std::string &error_msg)
 {
-std::ifstream ifs(omni_path, std::ios::binary);
-if (!ifs.is_open()) { error_msg = "File not found"; return false; }
+int fd = open(omni_path.c_str(), O_RDONLY | O_CLOEXEC);
+if (fd < 0) { error_msg = "File not found"; return false; }
 
+struct stat st;
+if (fstat(fd, &st) < 0) { close(fd); error_msg = "Failed to stat .omni file"; return false; }
 
-ifs.read(reinterpret_cast<char*>(&header), sizeof(header));
-if (!ifs) { error_msg = "Failed to read header"; return false; }
+std::vector<char> image(static_cast<size_t>(st.st_size));
+std::vector<IoSegment> segments = {{0, image.data(), image.size()}};
+bool ok = io::pread_all(fd, segments, error_msg);
+close(fd);
+if (!ok) return false;
 
-if (!load_user_table(ifs, header, user_manager, error_msg)) return false;
-if (!load_directory_tree(ifs, header, dir_tree, error_msg)) return false;
-if (!load_free_block_map(ifs, header, fbm, error_msg)) return false;
+ImageReader in(image);
+if (!in.read(&header, sizeof(header))) { error_msg = "Failed to read header"; return false; }
+
+if (!load_user_table(in, header, user_manager, error_msg)) return false;
+if (!load_directory_tree(in, header, dir_tree, error_msg)) return false;
+if (!load_free_block_map(in, header, fbm, error_msg)) return false;
 
-ifs.close();
 return true;
 
 
@@ -202,14 +217,12 @@ return true;
 // ====================================================
 // LOAD HELPERS
 // ====================================================
-bool PersistenceManager::load_user_table(std::ifstream &ifs, const OMNIHeader &header, UserManager &user_manager, std::string &error_msg) {
-ifs.seekg(static_cast<std::streamoff>(header.user_table_offset), std::ios::beg);
-if (!ifs.good()) { error_msg = "Failed to seek to user_table_offset"; return false; }
+bool PersistenceManager::load_user_table(ImageReader &in, const OMNIHeader &header, UserManager &user_manager, std::string &error_msg) {
+if (!in.seek(header.user_table_offset)) { error_msg = "Failed to seek to user_table_offset"; return false; }
 
 
 std::vector<UserInfo> users(header.max_users);
-ifs.read(reinterpret_cast<char*>(users.data()), sizeof(UserInfo) * header.max_users);
-if (!ifs) { error_msg = "Failed to read user table"; return false; }
+if (!in.read(users.data(), sizeof(UserInfo) * header.max_users)) { error_msg = "Failed to read user table"; return false; }
 
 user_manager.load_users(users);
 return true;
@@ -217,36 +230,49 @@ return true;
 
 }
 
-bool PersistenceManager::load_directory_tree(std::ifstream &ifs, const OMNIHeader &header, DirectoryTree &dir_tree, std::string &error_msg) {
+static void restore_files(DirectoryTree &dir_tree, DirNode *node, const std::vector<FileEntry> &files) {
+    for (auto &fe : files)
+        if (node->files.insert_or_assign(fe.name, fe).second) ++dir_tree.entry_counts()->files;
+}
+
+bool PersistenceManager::load_directory_tree(ImageReader &in, const OMNIHeader &header, DirectoryTree &dir_tree, std::string &error_msg) {
     uint64_t offset = header.user_table_offset + static_cast<uint64_t>(header.max_users) * sizeof(UserInfo);
-    ifs.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
-    if (!ifs.good()) { error_msg = "Failed to seek directory offset"; return false; }
+    if (!in.seek(offset)) { error_msg = "Failed to seek directory offset"; return false; }
 
     uint32_t node_count = 0;
-    ifs.read(reinterpret_cast<char*>(&node_count), sizeof(node_count));
-    if (!ifs) { error_msg = "Failed to read directory node count"; return false; }
+    if (!in.read(&node_count, sizeof(node_count))) { error_msg = "Failed to read directory node count"; return false; }
 
     for (uint32_t i = 0; i < node_count; ++i) {
         uint32_t path_len = 0;
-        ifs.read(reinterpret_cast<char*>(&path_len), sizeof(path_len));
-        if (!ifs) { error_msg = "Failed to read path length"; return false; }
+        if (!in.read(&path_len, sizeof(path_len))) { error_msg = "Failed to read path length"; return false; }
 
         std::string path(path_len, '\0');
-        ifs.read(path.data(), path_len);
-        if (!ifs) { error_msg = "Failed to read path"; return false; }
+        if (!in.read(path.data(), path_len)) { error_msg = "Failed to read path"; return false; }
 
         FileEntry entry;
-        ifs.read(reinterpret_cast<char*>(&entry), sizeof(entry));
-        if (!ifs) { error_msg = "Failed to read FileEntry"; return false; }
+        if (!in.read(&entry, ENTRY_DISK_BYTES)) { error_msg = "Failed to read FileEntry"; return false; }
 
         uint32_t file_count = 0;
-        ifs.read(reinterpret_cast<char*>(&file_count), sizeof(file_count));
-        if (!ifs) { error_msg = "Failed to read file count"; return false; }
+        if (!in.read(&file_count, sizeof(file_count))) { error_msg = "Failed to read file count"; return false; }
 
         std::vector<FileEntry> files(file_count);
         for (uint32_t j = 0; j < file_count; ++j) {
-            ifs.read(reinterpret_cast<char*>(&files[j]), sizeof(FileEntry));
-            if (!ifs) { error_msg = "Failed to read FileEntry"; return false; }
+            uint64_t content_len = 0;
+            if (!in.read(&files[j], ENTRY_DISK_BYTES) || !in.read(&content_len, sizeof(content_len))) {
+                error_msg = "Failed to read FileEntry";
+                return false;
+            }
+            if (content_len) {
+                auto content = std::make_shared<std::vector<char>>(static_cast<size_t>(content_len));
+                if (!in.read(content->data(), content->size())) { error_msg = "Failed to read file content"; return false; }
+                files[j].content = std::move(content);
+            }
+        }
+
+        // The root already exists in a fresh tree; only its files are restored.
+        if (path == "/") {
+            restore_files(dir_tree, dir_tree.get_root(), files);
+            continue;
         }
 
         // -------------------------------
@@ -260,9 +286,10 @@ entry.name[sizeof(entry.name)-1] = '\0';  // Ensure null-termination
         auto new_node = std::make_unique<DirNode>(entry);
 DirNode* node = new_node.get();
 parent->children[name] = std::move(new_node);
+++dir_tree.entry_counts()->directories;
 
 
-        for (auto &fe : files) node->files[fe.name] = fe;
+        restore_files(dir_tree, node, files);
     }
 
     return true;
@@ -271,22 +298,18 @@ parent->children[name] = std::move(new_node);
 // ====================================================
 // FREE BLOCK MAP LOADER
 // ====================================================
-bool PersistenceManager::load_free_block_map(std::ifstream &ifs, const OMNIHeader &header, FreeBlockManager &fbm, std::string &error_msg) {
-    ifs.seekg(static_cast<std::streamoff>(header.file_state_storage_offset), std::ios::beg);
-    if (!ifs.good()) { error_msg = "Failed to seek to free block map offset"; return false; }
+bool PersistenceManager::load_free_block_map(ImageReader &in, const OMNIHeader &header, FreeBlockManager &fbm, std::string &error_msg) {
+    if (!in.seek(header.file_state_storage_offset)) { error_msg = "Failed to seek to free block map offset"; return false; }
 
     uint64_t total_bits = 0;
-    ifs.read(reinterpret_cast<char*>(&total_bits), sizeof(total_bits));
-    if (!ifs) { error_msg = "Failed to read total bits"; return false; }
+    if (!in.read(&total_bits, sizeof(total_bits))) { error_msg = "Failed to read total bits"; return false; }
 
     uint64_t blk_size = 0;
-    ifs.read(reinterpret_cast<char*>(&blk_size), sizeof(blk_size));
-    if (!ifs) { error_msg = "Failed to read block size"; return false; }
+    if (!in.read(&blk_size, sizeof(blk_size))) { error_msg = "Failed to read block size"; return false; }
 
     uint64_t num_bytes = (total_bits + 7) / 8;
     std::vector<uint8_t> bytes(static_cast<size_t>(num_bytes), 0);
-    if (num_bytes > 0) ifs.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(num_bytes));
-    if (!ifs) { error_msg = "Failed to read free block map bytes"; return false; }
+    if (!in.read(bytes.data(), bytes.size())) { error_msg = "Failed to read free block map bytes"; return false; }
 
     std::vector<bool> bits(static_cast<size_t>(total_bits), false);
     for (uint64_t i = 0; i < total_bits; ++i) {
@@ -0,0 +1,82 @@
+#include "../include/rate_limiter.hpp"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+RateLimiter g_rate_limiter;
+
+void TokenBucket::refill(double rate, double burst, std::chrono::steady_clock::time_point now) {
+    if (tokens < 0) {
+        tokens = burst;
+    } else {
+        std::chrono::duration<double> elapsed = now - last;
+        tokens = std::min(burst, tokens + elapsed.count() * rate);
+    }
+    last = now;
+}
+
+void RateLimiter::configure(const RateLimits &session, const RateLimits &connection, double burst_secs) {
+    session_limits = session;
+    connection_limits = connection;
+    burst_seconds = burst_secs > 0 ? burst_secs : 1.0;
+    active = false;
+    for (size_t i = 0; i < LANE_COUNT; ++i)
+        active = active || session.per_second[i] || connection.per_second[i];
+}
+
+// A bucket always holds at least one request, however low the rate.
+double RateLimiter::burst(uint32_t rate) const {
+    return std::max(1.0, rate * burst_seconds);
+}
+
+// Wait until the bucket holds a whole token again.
+static uint32_t wait_ms(const TokenBucket &b, uint32_t rate) {
+    return static_cast<uint32_t>(std::ceil((1.0 - b.tokens) * 1000.0 / rate));
+}
+
+// A bucket that has refilled completely is indistinguishable from a new
+// one, so dropping it loses nothing.
+void RateLimiter::sweep(Shard &shard, std::chrono::steady_clock::time_point now) {
+    for (auto it = shard.sessions.begin(); it != shard.sessions.end();) {
+        bool idle = true;
+        for (size_t i = 0; i < LANE_COUNT && idle; ++i) {
+            uint32_t rate = session_limits.per_second[i];
+            if (!rate) continue;
+            TokenBucket &b = it->second.lane[i];
+            b.refill(rate, burst(rate), now);
+            idle = b.tokens >= burst(rate);
+        }
+        it = idle ? shard.sessions.erase(it) : std::next(it);
+    }
+}
+
+bool RateLimiter::admit(LaneBuckets &connection, const std::string &session_id, Lane lane, uint32_t &retry_after_ms) {
+    if (!active) return true;
+    size_t li = static_cast<size_t>(lane);
+    auto now = std::chrono::steady_clock::now();
+
+    uint32_t conn_rate = connection_limits.per_second[li];
+    TokenBucket *conn_bucket = nullptr;
+    if (conn_rate) {
+        conn_bucket = &connection.lane[li];
+        conn_bucket->refill(conn_rate, burst(conn_rate), now);
+        if (conn_bucket->tokens < 1.0) { retry_after_ms = wait_ms(*conn_bucket, conn_rate); return false; }
+    }
+
+    uint32_t sess_rate = session_limits.per_second[li];
+    if (sess_rate && !session_id.empty()) {
+        Shard &shard = shards[std::hash<std::string>{}(session_id) % SHARDS];
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        if (shard.sessions.size() >= SWEEP_THRESHOLD && now - shard.last_sweep > std::chrono::seconds(1)) {
+            sweep(shard, now);
+            shard.last_sweep = now;
+        }
+        TokenBucket &b = shard.sessions[session_id].lane[li];
+        b.refill(sess_rate, burst(sess_rate), now);
+        if (b.tokens < 1.0) { retry_after_ms = wait_ms(b, sess_rate); return false; }
+        b.tokens -= 1.0;
+    }
+
+    if (conn_bucket) conn_bucket->tokens -= 1.0;
+    return true;
+}
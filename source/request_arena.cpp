@@ -0,0 +1,20 @@
+#include "../include/request_arena.hpp"
+
+static thread_local RequestArena *t_arena = nullptr;
+
+RequestArena::RequestArena(size_t size)
+    : block(new char[size]),
+      pool(block.get(), size, std::pmr::new_delete_resource()) {}
+
+std::pmr::memory_resource* request_memory() {
+    return t_arena ? t_arena->resource() : std::pmr::new_delete_resource();
+}
+
+RequestArenaScope::RequestArenaScope(RequestArena &a) : arena(a) {
+    t_arena = &arena;
+}
+
+RequestArenaScope::~RequestArenaScope() {
+    t_arena = nullptr;
+    arena.reset();
+}
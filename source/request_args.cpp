@@ -0,0 +1,236 @@
+#include "../include/request_args.hpp"
+#include <cstring>
+
+namespace {
+
+// Where each field lives in RequestArgs; exactly one member pointer is set
+// for scalar fields, none for the structured ones.
+struct FieldInfo {
+    const char *key;
+    ParamType type;
+    std::string RequestArgs::*str;
+    uint64_t RequestArgs::*num;
+    bool RequestArgs::*flag;
+};
+
+const FieldInfo FIELDS[] = {
+    {"operation",     ParamType::STRING, &RequestArgs::operation,     nullptr, nullptr},
+    {"request_id",    ParamType::STRING, &RequestArgs::request_id,    nullptr, nullptr},
+    {"session_id",    ParamType::STRING, &RequestArgs::session_id,    nullptr, nullptr},
+    {"path",          ParamType::STRING, &RequestArgs::path,          nullptr, nullptr},
+    {"old_path",      ParamType::STRING, &RequestArgs::old_path,      nullptr, nullptr},
+    {"new_path",      ParamType::STRING, &RequestArgs::new_path,      nullptr, nullptr},
+    {"data",          ParamType::STRING, &RequestArgs::data,          nullptr, nullptr},
+    {"name",          ParamType::STRING, &RequestArgs::name,          nullptr, nullptr},
+    {"username",      ParamType::STRING, &RequestArgs::username,      nullptr, nullptr},
+    {"password",      ParamType::STRING, &RequestArgs::password,      nullptr, nullptr},
+    {"password_hash", ParamType::STRING, &RequestArgs::password_hash, nullptr, nullptr},
+    {"size",          ParamType::UINT,   nullptr, &RequestArgs::size,        nullptr},
+    {"index",         ParamType::UINT,   nullptr, &RequestArgs::index,       nullptr},
+    {"offset",        ParamType::UINT,   nullptr, &RequestArgs::offset,      nullptr},
+    {"chunk_size",    ParamType::UINT,   nullptr, &RequestArgs::chunk_size,  nullptr},
+    {"permissions",   ParamType::UINT,   nullptr, &RequestArgs::permissions, nullptr},
+    {"role",          ParamType::UINT,   nullptr, &RequestArgs::role,        nullptr},
+    {"last",          ParamType::BOOL,   nullptr, nullptr, &RequestArgs::last},
+    {"stop_on_error", ParamType::BOOL,   nullptr, nullptr, &RequestArgs::stop_on_error},
+    {"payload",       ParamType::OBJECT, nullptr, nullptr, nullptr},
+    {"operations",    ParamType::ARRAY,  nullptr, nullptr, nullptr},
+};
+static_assert(sizeof(FIELDS) / sizeof(FIELDS[0]) == static_cast<size_t>(Field::COUNT),
+              "FIELDS must list every Field in order");
+
+// Top-level keys; "password" only means something inside the payload.
+Field lookup_field(const std::string &key) {
+    for (size_t i = 0; i < static_cast<size_t>(Field::COUNT); ++i) {
+        if (static_cast<Field>(i) == Field::PASSWORD) continue;
+        if (key == FIELDS[i].key) return static_cast<Field>(i);
+    }
+    return Field::COUNT;
+}
+
+Field lookup_payload_field(const std::string &key) {
+    if (key == "username") return Field::USERNAME;
+    if (key == "password") return Field::PASSWORD;
+    return Field::COUNT;
+}
+
+uint32_t bit(Field f) { return 1u << static_cast<unsigned>(f); }
+
+void set_mistyped(RequestArgs &a, Field f) {
+    a.present |= bit(f);
+    a.mistyped |= bit(f);
+}
+
+void set_string(RequestArgs &a, Field f, std::string &&v) {
+    const FieldInfo &fi = FIELDS[static_cast<size_t>(f)];
+    if (fi.type != ParamType::STRING) { set_mistyped(a, f); return; }
+    a.*fi.str = std::move(v);
+    a.present |= bit(f);
+}
+
+void set_uint(RequestArgs &a, Field f, uint64_t v) {
+    const FieldInfo &fi = FIELDS[static_cast<size_t>(f)];
+    if (fi.type != ParamType::UINT) { set_mistyped(a, f); return; }
+    a.*fi.num = v;
+    a.present |= bit(f);
+}
+
+void set_bool(RequestArgs &a, Field f, bool v) {
+    const FieldInfo &fi = FIELDS[static_cast<size_t>(f)];
+    if (fi.type != ParamType::BOOL) { set_mistyped(a, f); return; }
+    a.*fi.flag = v;
+    a.present |= bit(f);
+}
+
+// SAX events for one request object. depth 1 is the request itself and
+// depth 2 the login payload; anything nested elsewhere is skipped.
+class ArgsSax {
+private:
+    RequestArgs &args;
+    int depth = 0;
+    int skip = 0;                   // levels inside a skipped value
+    Field current = Field::COUNT;   // field the next value belongs to
+
+    // True if the next value should be stored in `current`.
+    bool wanted() {
+        if (skip) return false;
+        if (depth == 0) { invalid = true; return false; }
+        return current != Field::COUNT;
+    }
+    bool scalar_done() {
+        current = Field::COUNT;
+        return !invalid;
+    }
+
+public:
+    bool needs_dom = false;
+    bool invalid = false;
+
+    explicit ArgsSax(RequestArgs &a) : args(a) {}
+
+    bool null() {
+        if (wanted()) set_mistyped(args, current);
+        return scalar_done();
+    }
+    bool boolean(bool v) {
+        if (wanted()) set_bool(args, current, v);
+        return scalar_done();
+    }
+    bool number_integer(json::number_integer_t) {   // only negative numbers get here
+        if (wanted()) set_mistyped(args, current);
+        return scalar_done();
+    }
+    bool number_unsigned(json::number_unsigned_t v) {
+        if (wanted()) set_uint(args, current, v);
+        return scalar_done();
+    }
+    bool number_float(json::number_float_t, const json::string_t &) {
+        if (wanted()) set_mistyped(args, current);
+        return scalar_done();
+    }
+    bool string(json::string_t &v) {
+        if (wanted()) set_string(args, current, std::move(v));
+        return scalar_done();
+    }
+    bool binary(json::binary_t &) {
+        if (wanted()) set_mistyped(args, current);
+        return scalar_done();
+    }
+
+    bool start_object(std::size_t) {
+        if (skip) { ++skip; return true; }
+        if (depth == 0) { depth = 1; return true; }
+        if (depth == 1 && current == Field::PAYLOAD) {
+            args.present |= bit(Field::PAYLOAD);
+            depth = 2;
+        } else {
+            if (current != Field::COUNT) set_mistyped(args, current);
+            skip = 1;
+        }
+        current = Field::COUNT;
+        return true;
+    }
+    bool end_object() {
+        if (skip) { --skip; return true; }
+        --depth;
+        current = Field::COUNT;
+        return true;
+    }
+    bool start_array(std::size_t) {
+        if (skip) { ++skip; return true; }
+        if (depth == 0) { invalid = true; return false; }
+        if (depth == 1 && current == Field::OPERATIONS) { needs_dom = true; return false; }
+        if (current != Field::COUNT) set_mistyped(args, current);
+        current = Field::COUNT;
+        skip = 1;
+        return true;
+    }
+    bool end_array() {
+        --skip;
+        return true;
+    }
+    bool key(json::string_t &k) {
+        if (skip) return true;
+        current = depth == 1 ? lookup_field(k) : lookup_payload_field(k);
+        return true;
+    }
+    bool parse_error(std::size_t, const std::string &, const nlohmann::detail::exception &) {
+        invalid = true;
+        return false;
+    }
+};
+
+} // namespace
+
+ParamType field_type(Field f) {
+    return FIELDS[static_cast<size_t>(f)].type;
+}
+
+const char* field_name(Field f) {
+    return FIELDS[static_cast<size_t>(f)].key;
+}
+
+bool parse_request(const char *begin, const char *end, RequestArgs &args, json &dom) {
+    ArgsSax sax(args);
+    bool ok = json::sax_parse(begin, end, &sax);
+    if (sax.needs_dom) {
+        dom = json::parse(begin, end, nullptr, false);
+        if (dom.is_discarded() || !dom.is_object()) return false;
+        args = RequestArgs();
+        args_from_json(dom, args);
+        return true;
+    }
+    return ok && !sax.invalid;
+}
+
+void args_from_json(const json &req, RequestArgs &args) {
+    if (!req.is_object()) return;
+    for (auto it = req.begin(); it != req.end(); ++it) {
+        Field f = lookup_field(it.key());
+        if (f == Field::COUNT) continue;
+        const json &v = it.value();
+        if (v.is_string()) {
+            set_string(args, f, v.get<std::string>());
+        } else if (v.is_number_unsigned()) {
+            set_uint(args, f, v.get<uint64_t>());
+        } else if (v.is_boolean()) {
+            set_bool(args, f, v.get<bool>());
+        } else if (f == Field::PAYLOAD && v.is_object()) {
+            args.present |= bit(f);
+            auto user = v.find("username");
+            if (user != v.end()) {
+                if (user->is_string()) set_string(args, Field::USERNAME, user->get<std::string>());
+                else set_mistyped(args, Field::USERNAME);
+            }
+            auto pass = v.find("password");
+            if (pass != v.end()) {
+                if (pass->is_string()) set_string(args, Field::PASSWORD, pass->get<std::string>());
+                else set_mistyped(args, Field::PASSWORD);
+            }
+        } else if (f == Field::OPERATIONS && v.is_array()) {
+            args.present |= bit(f);
+        } else {
+            set_mistyped(args, f);
+        }
+    }
+}
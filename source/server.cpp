@@ -1,14 +1,30 @@
 #include "server.hpp"
 #include "operations.hpp"
 #include "persistence_manager.hpp"
+#include "event_loop.hpp"
+#include "io_backend.hpp"
+#include "omni_header_builder.hpp"
+#include "shm_transport.hpp"
+#include "rate_limiter.hpp"
+#include "op_registry.hpp"
+#include "request_arena.hpp"
+#include "logger.hpp"
 #include <string>
 #include <pthread.h>
 #include <unistd.h>
 #include <signal.h>
 #include <atomic>
 #include <iostream>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <sched.h>
+#include <cstring>
+#include <sys/un.h>
 #include "include/globals.hpp"
 RequestQueue requestQueue;  
+static std::chrono::seconds queue_timeout{0}; // 0 = requests never expire
 
 
 
@@ -26,134 +42,264 @@ void save_all() {
 }
 
 // ===================== SIGNAL HANDLER =====================
-void signal_handler(int signum) {
-    std::cout << "\n[INFO] Signal received, shutting down...\n";
+// Only raises the flag; nothing else is safe in a handler. The event loops
+// notice it within a second and start_server() saves and exits from there.
+void signal_handler(int) {
     g_shutdown_flag = true;
-    save_all();
-    exit(0);
 }
   
   
 
 
-// ===================== WORKER THREAD =====================
-void* worker_thread(void*) {
-    while (!g_shutdown_flag) {
-        Request req = requestQueue.pop();  // blocks until a request is available
-
-        json response;
-        try {
-            response = dispatch_operation(req.request);
-        } catch (const std::exception &e) {
-            response = {{"status", "error"}, {"message", e.what()}, {"code", -500}};
+// ===================== SHM ATTACH =====================
+// Maps a client's shared memory channel (see shm_channel.hpp). Only
+// clients on the unix socket can do this, one channel per connection.
+static OFSErrorCodes op_shm_attach(OpContext &ctx, json &) {
+    const Request *req = ctx.origin;
+    auto channel = std::make_shared<ShmChannel>();
+    if (!req || !req->conn->local) {
+        ctx.error_message = "shm_attach is only available on the unix socket";
+    } else if (channel->attach(ctx.args.name, ctx.error_message)) {
+        bool attached = false;
+        {
+            std::lock_guard<std::mutex> lock(req->conn->out_mtx);
+            if (!req->conn->shm) { req->conn->shm = channel; attached = true; }
         }
-
-        response["operation"]  = req.request.value("operation", "");
-        response["request_id"] = req.request.value("request_id", "");
-        std::string out = response.dump() + "\n";
-        send(req.client_socket, out.c_str(), out.size(), 0);
+        if (attached) {
+            if (req->conn->closed) channel->close(); // the loop already let go of it
+            channel->start(requestQueue);
+            return OFSErrorCodes::SUCCESS;
+        }
+        ctx.error_message = "Connection already has a shared memory channel";
     }
-    return nullptr;
+    return OFSErrorCodes::ERROR_INVALID_OPERATION;
 }
 
+static OpRegistrar shm_attach_op({"shm_attach", op_shm_attach, {{Field::NAME, true}},
+                                  false, false, TreeAccess::NONE, Lane::CONTROL, false});
 
-
-// ===================== CLIENT THREAD =====================
-void* client_thread(void* arg) {
-    int client_socket = *(int*)arg;
-    delete (int*)arg;
-
-    char buffer[4096];
-    std::string data_buffer;
-
+// ===================== WORKER THREAD =====================
+// arg is the mask of lanes this worker serves.
+void* worker_thread(void* arg) {
+    unsigned lanes = static_cast<unsigned>(reinterpret_cast<uintptr_t>(arg));
+    ResponseBuffers out;   // reused for every response this worker sends
+    RequestArena arena;
     while (!g_shutdown_flag) {
-        int bytes = recv(client_socket, buffer, sizeof(buffer), 0);
-        if (bytes <= 0) {
-            close(client_socket);
-            return nullptr;
-        }
-
-        data_buffer.append(buffer, bytes);
-        size_t pos;
-        while ((pos = data_buffer.find('\n')) != std::string::npos) {
-            std::string message = data_buffer.substr(0, pos);
-            data_buffer.erase(0, pos + 1);
-            if (message.empty()) continue;
-
+        Request req = requestQueue.pop(lanes);  // blocks until a request is available
+        RequestArenaScope scratch(arena);       // released once the response is queued
+
+        bool framed = req.conn->protocol == WireProtocol::FRAMED;
+        std::shared_ptr<const std::vector<char>> payload_out;
+
+        if (queue_timeout.count() > 0 &&
+            std::chrono::steady_clock::now() - req.enqueued_at > queue_timeout) {
+            // Waited too long; the client has likely given up, so don't do the work.
+            out.response.clear();
+            write_error_response(out.response, req.args, static_cast<int32_t>(OFSErrorCodes::ERROR_QUEUE_TIMEOUT),
+                                 ofs_code_to_message(OFSErrorCodes::ERROR_QUEUE_TIMEOUT));
+            g_server_metrics.requests_timed_out++;
+        } else {
             try {
-                json request = json::parse(message);
-                Request r{request, client_socket};
-                requestQueue.push(r);
-            } catch (...) {
-                std::cerr << "[ERROR] Invalid JSON: " << message << "\n";
+                const json *dom = req.request.is_null() ? nullptr : &req.request;
+                if (framed) dispatch_operation(out, req.args, dom, &req.payload, &payload_out, &req);
+                else dispatch_operation(out, req.args, dom, nullptr, nullptr, &req);
+            } catch (const std::exception &e) {
+                out.response.clear();
+                payload_out.reset();
+                write_error_response(out.response, req.args, -500, e.what());
             }
         }
-    }
 
-    close(client_socket);
+        // The encoded response is copied once, into a buffer the connection
+        // owns until it is written; the shm ring copies it itself.
+        const std::string &body = out.response.str();
+        if (req.conn->protocol == WireProtocol::SHM) {
+            out.response.append("\n", 1);
+            req.conn->shm->send(body);
+        } else if (req.conn->protocol == WireProtocol::HTTP) {
+            // Errors travel in the JSON body, as on the other protocols.
+            std::string wire = http::build_response(200, body, req.http_keep_alive);
+            req.conn->loop->send_http_response(req.conn, req.http_seq, std::move(wire));
+        } else if (framed) {
+            std::string head = frame::encode(frame::Opcode::RESPONSE, body,
+                                             payload_out ? payload_out->size() : 0);
+            req.conn->loop->send_response(req.conn, std::move(head), std::move(payload_out));
+        } else {
+            out.response.append("\n", 1);
+            req.conn->loop->send_response(req.conn, std::string(body));
+        }
+        g_server_metrics.requests_completed++;
+    }
     return nullptr;
 }
 
 // ===================== START SERVER =====================
-void start_server(int port) {
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
-
-    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd < 0) { perror("socket failed"); exit(1); }
+// Every event loop binds its own socket to the same port; SO_REUSEPORT
+// makes the kernel spread incoming connections across them.
+static int open_listener(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) { perror("socket failed"); exit(1); }
 
     int opt = 1;
-    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) { perror("SO_REUSEPORT failed"); exit(1); }
 
     sockaddr_in addr{};
     addr.sin_family = AF_INET;
     addr.sin_port = htons(port);
     addr.sin_addr.s_addr = INADDR_ANY;
 
-    if (bind(server_fd, (sockaddr*)&addr, sizeof(addr)) < 0) { perror("bind failed"); exit(1); }
-    if (listen(server_fd, 50) < 0) { perror("listen failed"); exit(1); }
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0) { perror("bind failed"); exit(1); }
+    if (listen(fd, SOMAXCONN) < 0) { perror("listen failed"); exit(1); }
+    return fd;
+}
 
-    std::cout << "[INFO] Server running on port " << port << "\n";
+// A stale socket file from an earlier run would make bind() fail.
+static int open_unix_listener(const std::string &path) {
+    sockaddr_un addr{};
+    if (path.size() >= sizeof(addr.sun_path)) { std::cerr << "[ERROR] unix_socket_path too long\n"; exit(1); }
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) { perror("unix socket failed"); exit(1); }
+    unlink(path.c_str());
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0) { perror("unix bind failed"); exit(1); }
+    if (listen(fd, SOMAXCONN) < 0) { perror("unix listen failed"); exit(1); }
+    return fd;
+}
 
-    pthread_t worker;
-    pthread_create(&worker, nullptr, worker_thread, nullptr);
+static void pin_to_core(pthread_t thread, unsigned core) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    if (pthread_setaffinity_np(thread, sizeof(set), &set) != 0)
+        std::cerr << "[ERROR] Could not pin event loop to core " << core << "\n";
+}
 
-    while (!g_shutdown_flag) {
-        int client_socket = accept(server_fd, nullptr, nullptr);
-        if (client_socket < 0) { perror("accept failed"); continue; }
+static void* event_loop_thread(void* arg) {
+    static_cast<EventLoop*>(arg)->run();
+    return nullptr;
+}
 
-        int* sock_ptr = new int(client_socket);
-        pthread_t t;
-        pthread_create(&t, nullptr, client_thread, sock_ptr);
-        pthread_detach(t);
+void start_server(const Config &cfg) {
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    signal(SIGPIPE, SIG_IGN);
+
+    requestQueue.set_capacity(cfg.queue_capacity);
+    queue_timeout = std::chrono::seconds(cfg.queue_timeout);
+
+    RateLimits session_limits, connection_limits;
+    session_limits.per_second[static_cast<size_t>(Lane::CONTROL)] = cfg.session_rate_control;
+    session_limits.per_second[static_cast<size_t>(Lane::METADATA)] = cfg.session_rate_metadata;
+    session_limits.per_second[static_cast<size_t>(Lane::BULK)] = cfg.session_rate_bulk;
+    connection_limits.per_second[static_cast<size_t>(Lane::CONTROL)] = cfg.connection_rate_control;
+    connection_limits.per_second[static_cast<size_t>(Lane::METADATA)] = cfg.connection_rate_metadata;
+    connection_limits.per_second[static_cast<size_t>(Lane::BULK)] = cfg.connection_rate_bulk;
+    g_rate_limiter.configure(session_limits, connection_limits, cfg.burst_seconds);
+
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    unsigned loop_count = cfg.io_threads ? cfg.io_threads : cores;
+
+    // One event loop per core, each with its own listening sockets. The
+    // connection limit is enforced on the shared active-connection counter.
+    std::vector<std::unique_ptr<EventLoop>> loops;
+    std::vector<int> listen_fds;
+    for (unsigned i = 0; i < loop_count; ++i) {
+        auto loop = std::make_unique<EventLoop>(requestQueue, cfg.max_connections);
+        std::string err;
+        int server_fd = open_listener(cfg.port);
+        listen_fds.push_back(server_fd);
+        bool ok = loop->init(err) && loop->add_listener(server_fd, WireProtocol::UNKNOWN, false, err);
+        if (ok && cfg.http_port) {
+            int http_fd = open_listener(cfg.http_port);
+            listen_fds.push_back(http_fd);
+            ok = loop->add_listener(http_fd, WireProtocol::HTTP, false, err);
+        }
+        // Local clients are few; the first loop takes the unix socket.
+        if (ok && i == 0 && !cfg.unix_socket_path.empty()) {
+            int unix_fd = open_unix_listener(cfg.unix_socket_path);
+            listen_fds.push_back(unix_fd);
+            ok = loop->add_listener(unix_fd, WireProtocol::UNKNOWN, true, err);
+        }
+        if (!ok) { std::cerr << "[ERROR] Event loop init failed: " << err << "\n"; exit(1); }
+        loops.push_back(std::move(loop));
+    }
+    // Any loop may have connections paused on the full queue.
+    requestQueue.set_drain_listener([&loops] {
+        for (auto &loop : loops) loop->request_resume();
+    });
+
+    unsigned worker_count = cfg.worker_threads;
+    if (worker_count == 0) worker_count = cores;
+
+    std::cout << "[INFO] Server running on port " << cfg.port << " with " << loop_count
+              << " event loop(s), " << worker_count << " worker thread(s) and "
+              << cfg.bulk_workers << " bulk worker(s)\n";
+    if (cfg.http_port) std::cout << "[INFO] HTTP gateway on port " << cfg.http_port << "\n";
+    if (!cfg.unix_socket_path.empty()) std::cout << "[INFO] Unix socket at " << cfg.unix_socket_path << "\n";
+
+    // With dedicated bulk workers, the general pool never picks up a bulk
+    // transfer, so control and metadata requests always find a free worker.
+    unsigned general_lanes = cfg.bulk_workers ? lane_bit(Lane::CONTROL) | lane_bit(Lane::METADATA) : ALL_LANES;
+    std::vector<pthread_t> workers(worker_count + cfg.bulk_workers);
+    for (size_t i = 0; i < workers.size(); ++i) {
+        unsigned lanes = i < worker_count ? general_lanes : lane_bit(Lane::BULK);
+        pthread_create(&workers[i], nullptr, worker_thread, reinterpret_cast<void*>(static_cast<uintptr_t>(lanes)));
     }
 
+    std::vector<pthread_t> loop_threads(loop_count - 1);
+    for (unsigned i = 1; i < loop_count; ++i) {
+        pthread_create(&loop_threads[i - 1], nullptr, event_loop_thread, loops[i].get());
+        pin_to_core(loop_threads[i - 1], i % cores);
+    }
+    pin_to_core(pthread_self(), 0);
+    loops[0]->run();  // the first loop runs on this thread
+    std::cout << "\n[INFO] Signal received, shutting down...\n";
+    for (auto &t : loop_threads) pthread_join(t, nullptr);
+
     save_all();
-    close(server_fd);
+    for (int fd : listen_fds) close(fd);
+    if (!cfg.unix_socket_path.empty()) unlink(cfg.unix_socket_path.c_str());
+
+    // Workers stay parked on the request queue, and exit() would destroy it
+    // under them (and the logger's drain thread with it). Write out what is
+    // buffered and leave without running destructors.
+    logger::flush();
+    std::cout.flush();
+    std::cerr.flush();
+    _exit(0);
 }
 
 // ===================== SERVER INIT =====================
-void server_init(const std::string &omni_file, int port) {
+// The managers themselves are created in main() and shared with the
+// operation objects, so only their contents are loaded here.
+void server_init(const std::string &omni_file, const Config &cfg) {
     g_omni_file = omni_file;
-    g_user_mgr = new UserManager();
-    g_dir_tree = new DirectoryTree();
-    g_fbm = new FreeBlockManager();
+
+    // One allocation group per general worker, so concurrent creates rarely
+    // share a lock. Bulk workers never allocate (creates and deletes are
+    // metadata-lane operations), so they get no group of their own.
+    unsigned workers = cfg.worker_threads ? cfg.worker_threads : std::max(1u, std::thread::hardware_concurrency());
+    g_fbm->set_group_count(cfg.allocation_groups ? cfg.allocation_groups : workers);
+
+    IoBackend backend = io::select_backend(cfg.io_backend);
+    std::cout << "[INFO] I/O backend: " << io::backend_name(backend) << "\n";
 
     std::string err;
     if (!PersistenceManager::fs_load(g_omni_file, g_header, *g_user_mgr, *g_dir_tree, *g_fbm, err)) {
         std::cerr << "[INFO] No existing FS or failed to load: " << err << "\n";
+        g_header = OMNIHeaderBuilder::build(cfg);
+        g_fbm->init(cfg.total_size / cfg.block_size, cfg.block_size);
         uint64_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
         g_user_mgr->create_user("admin", "admin123", UserRole::ADMIN, now);
   
         std::cout << "[INFO] Admin user created.\n";
-  std::cout << "[DEBUG] user check: " << g_user_mgr->find_user("admin") << "\n";
-  std::cout << "[DEBUG] dumping all users:\n";
-g_user_mgr->dump_users();  // just call it; it prints internally
-
-
     } else {
         std::cout << "[INFO] Loaded existing FS from " << g_omni_file << "\n";
     }
+    std::cout << "[INFO] Free space split into " << g_fbm->group_count() << " allocation group(s)\n";
 
-    start_server(port);
+    start_server(cfg);
 }
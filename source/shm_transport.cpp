@@ -0,0 +1,151 @@
+#include "../include/shm_transport.hpp"
+#include "../include/event_loop.hpp"
+#include "../include/operations.hpp"
+#include "../include/globals.hpp"
+#include "../include/logger.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <iostream>
+
+static const int SHM_WAIT_MS = 100;   // doorbell sleep; bounds how long close() takes to notice
+static const int SHM_SEND_TIMEOUT_MS = 5000;   // no room for this long: the client stopped reading
+
+ShmChannel::~ShmChannel() {
+    if (layout) munmap(layout, map_size);
+}
+
+bool ShmChannel::attach(const std::string &shm_name, std::string &error_msg) {
+    int fd = shm_open(shm_name.c_str(), O_RDWR, 0);
+    if (fd < 0) { error_msg = "Cannot open shared memory " + shm_name; return false; }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(shm::Layout)) {
+        ::close(fd);
+        error_msg = "Shared memory segment too small";
+        return false;
+    }
+    void *p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) { error_msg = "Failed to map shared memory"; return false; }
+    layout = static_cast<shm::Layout*>(p);
+    map_size = static_cast<size_t>(st.st_size);
+
+    // The client can keep writing to the header; read ring_bytes exactly
+    // once (volatile, so the compiler cannot re-load it) and use the copy.
+    uint64_t ring_bytes = *static_cast<volatile uint64_t*>(&layout->ring_bytes);
+    if (layout->magic != shm::MAGIC || layout->version != shm::VERSION ||
+        !shm::valid_ring_bytes(ring_bytes) || map_size < shm::segment_size(ring_bytes)) {
+        error_msg = "Bad shared memory channel header";
+        return false;
+    }
+    name = shm_name;
+    requests = shm::request_ring(layout, ring_bytes);
+    responses = shm::response_ring(layout, ring_bytes);
+    return true;
+}
+
+void ShmChannel::start(RequestQueue &queue) {
+    auto self = shared_from_this();
+    std::thread([self, &queue] { self->reader_loop(queue); }).detach();
+}
+
+bool ShmChannel::closed() const {
+    return stopping || layout->closed.load(std::memory_order_acquire);
+}
+
+void ShmChannel::close() {
+    stopping = true;
+}
+
+// ===================== REQUESTS =====================
+void ShmChannel::reader_loop(RequestQueue &queue) {
+    // Responses go back through the channel, not a socket; the connection
+    // only exists so requests look like any other to the workers.
+    auto conn = std::make_shared<Connection>();
+    conn->protocol = WireProtocol::SHM;
+    conn->shm = shared_from_this();
+
+    std::string buf;
+    std::vector<char> chunk(64 * 1024);
+    while (!closed() && !g_shutdown_flag) {
+        size_t n = requests.read_some(chunk.data(), chunk.size());
+        if (n == 0 && requests.inconsistent()) {
+            LOG_WARN("Inconsistent request ring on shm channel %s, closing", name.c_str());
+            close();
+            break;
+        }
+        if (n == 0) { requests.wait_data(SHM_WAIT_MS); continue; }
+        buf.append(chunk.data(), n);
+
+        size_t start = 0, pos;
+        while ((pos = buf.find('\n', start)) != std::string::npos) {
+            size_t line_start = start;
+            start = pos + 1;
+            if (pos == line_start) continue;
+
+            Request r;
+            if (!parse_request(buf.data() + line_start, buf.data() + pos, r.args, r.request)) {
+                LOG_ERROR("Invalid JSON on shm channel %s", name.c_str());
+                continue;
+            }
+            r.conn = conn;
+            r.lane = operation_lane(r.args.operation, false);
+            uint32_t retry_after_ms = 0;
+            if (!g_rate_limiter.admit(conn->limits, r.args.session_id, r.lane, retry_after_ms)) {
+                g_server_metrics.requests_throttled++;
+                send(throttled_response(r.args, retry_after_ms).dump() + "\n");
+                continue;
+            }
+            // Full lane: the client waits like a paused socket would.
+            while (!queue.try_push(std::move(r))) {
+                if (closed()) { conn->closed = true; return; }
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+            g_server_metrics.requests_enqueued++;
+        }
+        if (start > 0) buf.erase(0, start);
+        // Same cap as a socket connection: no newline within MAX_LINE_BYTES
+        // means the client is not speaking the protocol.
+        if (buf.size() > EventLoop::MAX_LINE_BYTES) {
+            LOG_WARN("Request line too long on shm channel %s, closing", name.c_str());
+            close();
+            break;
+        }
+    }
+    conn->closed = true;
+}
+
+// ===================== RESPONSES =====================
+void ShmChannel::send(const std::string &data) {
+    std::lock_guard<std::mutex> lock(send_mtx);
+    size_t done = 0;
+    auto last_progress = std::chrono::steady_clock::now();
+    while (done < data.size()) {
+        if (closed()) return;
+        size_t n = responses.write_some(data.data() + done, data.size() - done);
+        if (n == 0 && responses.inconsistent()) {
+            LOG_WARN("Inconsistent response ring on shm channel %s, closing", name.c_str());
+            close();
+            return;
+        }
+        if (n == 0) {
+            // A worker must not block here forever on a client that quit
+            // reading without closing the channel.
+            if (std::chrono::steady_clock::now() - last_progress > std::chrono::milliseconds(SHM_SEND_TIMEOUT_MS)) {
+                LOG_WARN("Response ring full for %d ms on shm channel %s, closing",
+                         SHM_SEND_TIMEOUT_MS, name.c_str());
+                close();
+                return;
+            }
+            responses.wait_space(SHM_WAIT_MS);
+            continue;
+        }
+        done += n;
+        last_progress = std::chrono::steady_clock::now();
+    }
+}
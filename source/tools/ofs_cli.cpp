@@ -0,0 +1,112 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <getopt.h>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include "../include/client.hpp"
+
+// Command line front end for OFSClient. Requests are JSON objects, given
+// as arguments or one per line on stdin; they are pipelined over the pool
+// and each response is printed on its own line as it arrives.
+
+static const size_t MAX_IN_FLIGHT = 256; // caps memory when reading a long stdin
+static const unsigned long MAX_CONNECTIONS = 1024;
+
+// A whole decimal number in [lo, hi]; anything else is rejected.
+static bool parse_number(const char *text, unsigned long lo, unsigned long hi, unsigned long &out) {
+    if (!std::isdigit(static_cast<unsigned char>(text[0]))) return false;
+    char *end = nullptr;
+    errno = 0;
+    unsigned long v = std::strtoul(text, &end, 10);
+    if (errno != 0 || *end != '\0' || v < lo || v > hi) return false;
+    out = v;
+    return true;
+}
+
+static void usage(const char *prog) {
+    std::cerr << "Usage: " << prog << " [-H host] [-p port] [-s unix_socket] [-c connections]\n"
+              << "       [-u username -P password] [-t timeout_ms] ['<json request>' ...]\n"
+              << "Without request arguments, requests are read from stdin, one per line.\n"
+              << "-c takes 1-" << MAX_CONNECTIONS << "; -t 0 waits forever.\n";
+}
+
+int main(int argc, char* argv[]) {
+    ClientOptions opts;
+    std::string username, password;
+    int c;
+    unsigned long n;
+    while ((c = getopt(argc, argv, "H:p:s:c:u:P:t:h")) != -1) {
+        switch (c) {
+            case 'H': opts.host = optarg; break;
+            case 'p':
+                if (!parse_number(optarg, 1, 65535, n)) { usage(argv[0]); return 2; }
+                opts.port = static_cast<uint16_t>(n);
+                break;
+            case 's': opts.unix_socket_path = optarg; break;
+            case 'c':
+                if (!parse_number(optarg, 1, MAX_CONNECTIONS, n)) { usage(argv[0]); return 2; }
+                opts.pool_size = n;
+                break;
+            case 'u': username = optarg; break;
+            case 'P': password = optarg; break;
+            case 't':
+                if (!parse_number(optarg, 0, INT_MAX, n)) { usage(argv[0]); return 2; }
+                opts.request_timeout_ms = static_cast<int>(n);
+                break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+
+    OFSClient client(opts);
+    std::string err;
+    if (!client.connect(err)) { std::cerr << "[ERROR] " << err << "\n"; return 1; }
+    if (!username.empty() && !client.login(username, password, err)) {
+        std::cerr << "[ERROR] Login failed: " << err << "\n";
+        return 1;
+    }
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    size_t outstanding = 0;
+    bool failed = false;
+
+    auto submit = [&](const std::string &text) {
+        json request = json::parse(text, nullptr, false);
+        if (request.is_discarded()) {
+            std::cerr << "[ERROR] Invalid JSON: " << text << "\n";
+            std::lock_guard<std::mutex> lock(mtx);
+            failed = true;
+            return;
+        }
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [&] { return outstanding < MAX_IN_FLIGHT; });
+            ++outstanding;
+        }
+        client.send_async(std::move(request), [&](const json &res) {
+            std::lock_guard<std::mutex> lock(mtx);
+            std::cout << res.dump() << "\n";
+            if (res.value("status", "") != "success") failed = true;
+            --outstanding;
+            cv.notify_all();
+        });
+    };
+
+    if (optind < argc) {
+        for (int i = optind; i < argc; ++i) submit(argv[i]);
+    } else {
+        std::string line;
+        while (std::getline(std::cin, line))
+            if (!line.empty()) submit(line);
+    }
+
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [&] { return outstanding == 0; });
+    std::cout.flush();
+    return failed ? 1 : 0;
+}
@@ -1,13 +1,15 @@
 #include "user_manager.hpp"
-#include <iostream>
+#include "logger.hpp"
 
 void UserManager::load_users(const std::vector<UserInfo>& user_table) {
+    std::unique_lock<std::shared_mutex> lock(mtx);
     users.clear();
     for (auto& u : user_table)
-        users[u.username] = u;
+        if (u.username[0]) users[u.username] = u;   // unused slots of the table are blank
 }
 
 std::vector<UserInfo> UserManager::save_users() const {
+    std::shared_lock<std::shared_mutex> lock(mtx);
     std::vector<UserInfo> out;
     for (auto& kv : users)
         out.push_back(kv.second);
@@ -19,60 +21,67 @@ bool UserManager::create_user(const std::string& username,
                               UserRole role,
                               uint64_t created_time) 
 {
+    std::unique_lock<std::shared_mutex> lock(mtx);
     if (users.count(username)) return false;
 
     // ❌ REMOVE HASHING — store password directly
     users[username] = UserInfo(username, pwd, role, created_time);
 
-    std::cout << "[DEBUG create_user] stored user '" << username
-              << "' password_plain = '" << pwd << "'\n";
+    LOG_DEBUG("create_user: stored user '%s'", username.c_str());
 
     return true;
 }
 
+size_t UserManager::user_count() const {
+    std::shared_lock<std::shared_mutex> lock(mtx);
+    return users.size();
+}
+
 bool UserManager::delete_user(const std::string& username) {
+    std::unique_lock<std::shared_mutex> lock(mtx);
     return users.erase(username) > 0;
 }
 
-UserInfo* UserManager::find_user(const std::string &username) {
-    for (auto &kv : users) { // kv.first = key, kv.second = UserInfo
-        std::cout << "[DEBUG find_user] key='" << kv.first 
-                  << "' username='" << kv.second.username << "'\n";
-        if (kv.first == username) // match map key directly
-            return &kv.second;
-    }
-    return nullptr;
+UserInfo* UserManager::find_user_locked(const std::string &username) {
+    auto it = users.find(username);
+    LOG_DEBUG("find_user: '%s' %s", username.c_str(), it == users.end() ? "not found" : "found");
+    return it == users.end() ? nullptr : &it->second;
+}
+
+bool UserManager::find_user(const std::string &username, UserInfo &out) {
+    std::shared_lock<std::shared_mutex> lock(mtx);
+    UserInfo* u = find_user_locked(username);
+    if (!u) return false;
+    out = *u;
+    return true;
 }
 
 
 
 
 bool UserManager::verify_password(const std::string& username, const std::string& incoming_pwd) {
-    auto u = find_user(username);
+    std::shared_lock<std::shared_mutex> lock(mtx);
+    auto u = find_user_locked(username);
     if (!u) {
-        std::cout << "[DEBUG verify_password] user not found: " << username << "\n";
+        LOG_DEBUG("verify_password: user not found: %s", username.c_str());
         return false;
     }
 
-    std::cout << "[DEBUG verify_password] stored='" << u->password_hash 
-              << "' incoming='" << incoming_pwd << "'\n";
-
     // ✔ Direct comparison — no hashing
-    return u->password_hash == incoming_pwd;
+    bool ok = u->password_hash == incoming_pwd;
+    LOG_DEBUG("verify_password: user '%s' %s", username.c_str(), ok ? "matched" : "mismatch");
+    return ok;
 }
   
 void UserManager::dump_users() const {
-    std::cout << "[DEBUG dump_users] total users: " << users.size() << "\n";
+    std::shared_lock<std::shared_mutex> lock(mtx);
+    LOG_DEBUG("dump_users: total users: %zu", users.size());
     for (const auto &kv : users) {
         const UserInfo &u = kv.second;
-        std::cout << "  key='" << kv.first 
-                  << "' username='" << u.username 
-                  << "' password='" << u.password_hash 
-                  << "' role=" << static_cast<int>(u.role)
-                  << " created_time=" << u.created_time
-                  << " last_login=" << u.last_login
-                  << " is_active=" << u.is_active
-                  << "\n";
+        LOG_DEBUG("  key='%s' username='%.32s' role=%d created_time=%llu last_login=%llu is_active=%d",
+                  kv.first.c_str(), u.username, static_cast<int>(u.role),
+                  static_cast<unsigned long long>(u.created_time),
+                  static_cast<unsigned long long>(u.last_login), static_cast<int>(u.is_active));
     }
 }
 